@@ -14,89 +14,178 @@
 #include "msdelay.h"            /* for ms_delay */
 
 #include "OML.h"
+#include "jit.c"                /* for OML_jit_loop */
+#include "pool.c"               /* for OML_pool_run */
+#include "arena.c"              /* for arena_alloc */
+#include "output.c"             /* for out_write */
+#include "input.c"              /* for in_int */
+#include "bigint.c"             /* for big_add */
+#include "prime.c"              /* for is_prime */
+#include "vector.c"             /* for stack_sum */
+#include "profile.c"            /* for OML_profile_tick */
 
 #define INITIAL_STACK_CAPACITY (16)
-#define eprintf(...) fprintf(stderr, __VA_ARGS__)
-#define debug_printf(...) printf("\x1b[33m[%s::%i]\x1b[0m ", __FUNCTION__, __LINE__);printf(__VA_ARGS__)
+// members an `e{' must map before its body is spread across threads
+#define PARALLEL_MAP_MIN (1024)
 
-char* read_file(char* name, size_t* out_size) {
-    FILE* file = fopen(name, "r");
-    if(!file) {
-        fprintf(stderr, "Error: no such file %s\n", name);
-        return NULL;
-    }
-    size_t length;
-    char* contents;
-    *out_size = 0;
-
-    if(fseeko(file, 0, SEEK_END) != 0) {
-        return NULL;
-    }
+static const char ALPHABET[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 
-    length = ftello(file);
+// the most cells a stack buffer can have, a power of two whose size in bytes
+// still fits in a size_t
+#define STACK_MAX_CAPACITY  (SIZE_MAX / sizeof(int64_t) / 2 + 1)
 
-    if(fseeko(file, 0, SEEK_SET) != 0) {
-        return NULL;
+// a buffer of `capacity' cells from the allocator of `stk'
+static int64_t* stack_buffer(STACK* stk, size_t capacity) {
+    if(stk->arena) {
+        return arena_alloc(stk->arena, sizeof(int64_t) * capacity);
     }
-
-    contents = malloc(length * sizeof(char));
-    fread(contents, sizeof(char), length, file);
-
-    fclose(file);
-
-    *out_size = length;
-
-    return contents;
+    return malloc(sizeof(int64_t) * capacity);
 }
 
 STACK stack_init(void) {
-    STACK res = { INITIAL_STACK_CAPACITY, 0, NULL };
+    return stack_init_in(NULL);
+}
+
+// a stack whose memory belongs to `arena', or is malloc'd if that is NULL
+STACK stack_init_in(struct OML_ARENA* arena) {
+    STACK res = { INITIAL_STACK_CAPACITY, 0, 0, 0, NULL, arena };
     
-    res.data = malloc(sizeof(int64_t) * res.capacity);
+    res.data = stack_buffer(&res, res.capacity);
 
     return res;
 }
 
 void stack_destroy(STACK* stk) {
-    free(stk->data);
+    // arena memory is released with the arena
+    if(stk->arena == NULL) {
+        free(stk->data);
+    }
 }
 
-int stack_resize(STACK* stk) {
-    void* temp = realloc(stk->data, sizeof(int64_t) * stk->capacity);
+// moves the frames and members into a fresh buffer of `capacity' cells,
+// starting at 0
+static int stack_relocate(STACK* stk, size_t capacity) {
+    int64_t* temp = stack_buffer(stk, capacity);
     
     if(temp == NULL) {
         return 0;
     }
     
+    size_t start = (stk->head - stk->base) & (stk->capacity - 1);
+    size_t count = stk->base + stk->size;
+    size_t first = stk->capacity - start;
+    if(first > count) {
+        first = count;
+    }
+    memcpy(temp, stk->data + start, first * sizeof(int64_t));
+    memcpy(temp + first, stk->data, (count - first) * sizeof(int64_t));
+    stk->stats.resizes++;
+    stk->stats.copied += count * sizeof(int64_t);
+    
+    stack_destroy(stk);
     stk->data = temp;
+    stk->capacity = capacity;
+    stk->head = stk->base;
     
     return 1;
 }
 
+// doubles the capacity, unwrapping the cells to the start of the buffer
+int stack_resize(STACK* stk) {
+    return stack_relocate(stk, stk->capacity * 2);
+}
+
+// grows the stack so that `count' more members fit without resizing; 0 if
+// they cannot, for want of memory or as more than a buffer can hold
+int stack_reserve(STACK* stk, size_t count) {
+    size_t used = stk->base + stk->size;
+    if(count >= STACK_MAX_CAPACITY - used) {
+        return 0;
+    }
+    size_t capacity = stk->capacity;
+    while(used + count >= capacity) {
+        capacity *= 2;
+    }
+    return capacity == stk->capacity || stack_relocate(stk, capacity);
+}
+
+// makes the frames and members contiguous from data[0], for code that
+// walks them raw; the members then start at data[base]
+int stack_linearize(STACK* stk) {
+    if(stk->head == stk->base) {
+        return 1;
+    }
+    size_t start = (stk->head - stk->base) & (stk->capacity - 1);
+    size_t count = stk->base + stk->size;
+    if(start + count <= stk->capacity) {
+        memmove(stk->data, stk->data + start, count * sizeof(int64_t));
+        stk->head = stk->base;
+        return 1;
+    }
+    return stack_relocate(stk, stk->capacity);
+}
+
+/*
+ * The slow path of a push: a stack past its peak counts the new one, and a
+ * full one is resized. Pushes take it only while the stack climbs past its
+ * peak, so that keeping the peak costs nothing once a program settles.
+ */
+static int stack_grow(STACK* stk) {
+    STACK_NOTE_PEAK(stk);
+    stk->limit = stk->stats.peak + 1 < stk->capacity ? stk->stats.peak + 1 : stk->capacity;
+    if(stk->base + stk->size >= stk->capacity) {
+        return stack_resize(stk);
+    }
+    return 1;
+}
+
 int stack_push(STACK* stk, int64_t val) {
-    stk->data[stk->size++] = val;
+    STACK_AT(stk, stk->size) = val;
+    stk->size++;
     
-    if(stk->size >= stk->capacity) {
-        stk->capacity *= 2;
-        return stack_resize(stk);
+    if(stk->base + stk->size >= stk->limit) {
+        return stack_grow(stk);
     }
     
     return 1;
 }
 
+// discards the bottom member, sliding the enclosing frames up a cell
+static void stack_drop_bottom(STACK* stk) {
+    size_t mask = stk->capacity - 1;
+    size_t start = stk->head - stk->base;
+    for(size_t i = stk->base; i > 0; i--) {
+        stk->data[(start + i) & mask] = stk->data[(start + i - 1) & mask];
+    }
+    stk->head = (stk->head + 1) & mask;
+    stk->size--;
+}
+
 int stack_unshift(STACK* stk, int64_t val) {
-    stk->size++;
-    
-    if(stk->size >= stk->capacity) {
-        stk->capacity *= 2;
-        if(!stack_resize(stk)) {
+    if(stk->base > stk->size) {
+        // cheaper to slide the members up than the frames down
+        if(!stack_push(stk, val)) {
             return 0;
         }
+        for(size_t i = stk->size - 1; i > 0; i--) {
+            STACK_AT(stk, i) = STACK_AT(stk, i - 1);
+        }
+        STACK_AT(stk, 0) = val;
+        return 1;
     }
     
-    memmove(stk->data + 1, stk->data, stk->size * sizeof(int64_t));
+    size_t mask = stk->capacity - 1;
+    stk->head = (stk->head - 1) & mask;
+    size_t start = stk->head - stk->base;
+    for(size_t i = 0; i < stk->base; i++) {
+        stk->data[(start + i) & mask] = stk->data[(start + i + 1) & mask];
+    }
+    stk->data[stk->head] = val;
+    stk->size++;
     
-    stk->data[0] = val;
+    if(stk->base + stk->size >= stk->limit) {
+        return stack_grow(stk);
+    }
     
     return 1;
 }
@@ -105,47 +194,101 @@ int64_t stack_pop(STACK* stk) {
     if(stk->size == 0)
         return 0;
     
-    int64_t res = stk->data[--stk->size];
+    int64_t res = STACK_AT(stk, --stk->size);
     
     return res;
 }
 
 int64_t stack_shift(STACK* stk) {
-    int64_t val = stk->data[0];
+    if(stk->size == 0)
+        return 0;
     
-    stk->size--;
+    int64_t val = STACK_AT(stk, 0);
     
-    memmove(stk->data, stk->data + 1, stk->size * sizeof(int64_t));
+    if(stk->base > stk->size) {
+        // cheaper to slide the members down than the frames up
+        for(size_t i = 0; i + 1 < stk->size; i++) {
+            STACK_AT(stk, i) = STACK_AT(stk, i + 1);
+        }
+        stk->size--;
+    }
+    else {
+        stack_drop_bottom(stk);
+    }
     
     return val;
 }
 
+// removes the member at `index', closing the gap from whichever end is nearer
 int64_t stack_pop_from(STACK* stk, size_t index) {
-    int64_t val;
-    size_t to_move;
-    
-    val = stk->data[index];
-    stk->size--;
+    if(index >= stk->size)
+        return 0;
     
-    to_move = stk->size - index;
+    int64_t val = STACK_AT(stk, index);
     
-    memmove(stk->data + index, stk->data + index + 1, to_move * sizeof(int64_t));
+    if(index + stk->base < stk->size - index) {
+        for(size_t i = index; i > 0; i--) {
+            STACK_AT(stk, i) = STACK_AT(stk, i - 1);
+        }
+        stack_drop_bottom(stk);
+    }
+    else {
+        for(size_t i = index; i + 1 < stk->size; i++) {
+            STACK_AT(stk, i) = STACK_AT(stk, i + 1);
+        }
+        stk->size--;
+    }
     
     return val;
 }
 
+// opens a frame over the top `count' members, hiding the rest beneath it
+void stack_enter(STACK* stk, size_t count) {
+    size_t hidden = stk->size - count;
+    stk->head = (stk->head + hidden) & (stk->capacity - 1);
+    stk->base += hidden;
+    stk->size = count;
+}
+
+// closes a frame, restoring the `hidden' members beneath it
+void stack_leave(STACK* stk, size_t hidden) {
+    stk->head = (stk->head - hidden) & (stk->capacity - 1);
+    stk->base -= hidden;
+    stk->size += hidden;
+}
+
 int64_t stack_peek(STACK* stk) {
     if(stk->size == 0)
         return 0;
     
-    return stk->data[stk->size - 1];
+    return STACK_AT(stk, stk->size - 1);
 }
 
-void stack_display(STACK t) {
-    fflush(stdout);
-    
+void stack_display(struct OML_OUTPUT* out, STACK t) {
+    char buf[FORMAT_INT_SIZE + 1];
+    for(size_t i = t.size - 1; i < t.size; --i) {
+        size_t size = format_int(buf, STACK_AT(&t, i), 10);
+        buf[size] = '\n';
+        out_write(out, 1, buf, size + 1);
+    }
+}
+
+// stack_display, for an instance that may hold big numbers
+void OML_display(OML* inst, STACK t) {
+    if(!inst->bigint) {
+        stack_display(inst->out, t);
+        return;
+    }
+    char buf[FORMAT_INT_SIZE];
     for(size_t i = t.size - 1; i < t.size; --i) {
-        printf("%"PRId64"\n", t.data[i]);
+        int64_t n = STACK_AT(&t, i);
+        if(BIG_IS(n)) {
+            big_write(inst, 1, n, 10);
+        }
+        else {
+            out_write(inst->out, 1, buf, format_int(buf, n, 10));
+        }
+        out_char(inst->out, 1, '\n');
     }
 }
 
@@ -155,38 +298,99 @@ void stack_push_int_array(STACK* stk, int64_t* arr, size_t size) {
     }
 }
 
+// reverses the order of the top `count' members
+void stack_reverse(STACK* stk) {
+    stack_reverse_top(stk, stk->size);
+}
+
 void stack_clear(STACK* stk) {
     stk->size = 0;
 }
 
+// empties the stack, giving the number its members are the digits of in
+// `base', the bottom one most significant, wrapping at 64 bits
+int64_t stack_from_base(STACK* stk, int64_t base) {
+    int64_t sum = 0;
+    for(size_t pos = 0; pos < stk->size; pos++) {
+        sum = (uint64_t) sum * base + STACK_AT(stk, pos);
+    }
+    stk->size = 0;
+    return sum;
+}
+
+// adds the costs of `part' to `total'; peaks are not added but compared
+void stack_stats_add(STACK_STATS* total, STACK_STATS part) {
+    total->resizes += part.resizes;
+    total->copied += part.copied;
+    total->peak = part.peak > total->peak ? part.peak : total->peak;
+}
+
 STACK stack_from(STACK stk) {
-    STACK res = stack_init();
-    res.size = stk.size;
-    res.capacity = stk.capacity;
+    STACK res = { stk.capacity, stk.size, 0, 0, NULL, stk.arena };
+    
+    res.data = stack_buffer(&res, res.capacity);
     
     for(size_t i = 0; i < res.size; i++) {
-        res.data[i] = stk.data[i];
+        res.data[i] = STACK_AT(&stk, i);
     }
     
     return res;
 }
 
-bool stdin_remaining(void) {
-    ungetc(getchar(), stdin);
-    
-    return feof(stdin) == 0;
+bool stdin_remaining(OML* inst) {
+    return in_peek(inst->in) != EOF;
 }
 
-double random_scale(void) {
-    uint64_t rand_val = next();
-    
-    return rand_val * 1.0 / UINT64_MAX; 
+// a uniform random number in [0, bound), or 0 if bound is 0. the high word
+// of a 128-bit product scales a draw with no division; the draws that would
+// make some results more likely than others are rejected and redrawn, which
+// happens with a chance of bound / 2^64, and only then is `%' needed
+static inline uint64_t random_below(uint64_t* rng, uint64_t bound) {
+    __uint128_t m = (__uint128_t) next(rng) * bound;
+    uint64_t low = m;
+    if(low < bound) {
+        uint64_t threshold = -bound % bound;
+        while(low < threshold) {
+            m = (__uint128_t) next(rng) * bound;
+            low = m;
+        }
+    }
+    return m >> 64;
 }
 
-int64_t random_between(int64_t lower, int64_t upper) {
-    double scale = random_scale();
-    
-    return (int64_t)(scale * (upper - lower)) + lower;
+// a random number between 0 and `bound', excluding `bound', with the sign of
+// `bound'
+int64_t random_int(OML* inst, int64_t bound) {
+    if(bound < 0) {
+        return -(int64_t) random_below(inst->rng, -(uint64_t) bound);
+    }
+    return random_below(inst->rng, bound);
+}
+
+// pushes `count' numbers, the same as `count' calls of random_int(bound)
+void random_fill(OML* inst, STACK* stk, int64_t count, int64_t bound) {
+    if(count <= 0) {
+        return;
+    }
+    if((uint64_t) count >= STACK_MAX_CAPACITY || !stack_reserve(stk, count)) {
+        OML_fail(inst, "no room for that many random numbers");
+    }
+    uint64_t limit = bound < 0 ? -(uint64_t) bound : (uint64_t) bound;
+    uint64_t threshold = limit ? -limit % limit : 0;
+    // a local copy of the state can stay in registers
+    uint64_t rng[2] = { inst->rng[0], inst->rng[1] };
+    for(int64_t i = 0; i < count; i++) {
+        __uint128_t m;
+        do {
+            m = (__uint128_t) next(rng) * limit;
+        } while((uint64_t) m < threshold);
+        int64_t value = m >> 64;
+        STACK_AT(stk, stk->size + i) = bound < 0 ? -value : value;
+    }
+    stk->size += count;
+    STACK_NOTE_PEAK(stk);
+    inst->rng[0] = rng[0];
+    inst->rng[1] = rng[1];
 }
 
 int64_t factorial(int64_t n) {
@@ -258,154 +462,187 @@ int is_power(int64_t num, int64_t base) {
     return num == 1;
 }
 
-int64_t* to_base(int64_t n, int64_t base, size_t* out_size) {
-    double ratio = round(log(n) / log(base));
+// "00" through "99", for writing base 10 numbers two digits at a time
+static const char DIGIT_PAIRS[200] =
+    "00010203040506070809" "10111213141516171819"
+    "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
 
-    *out_size = 1 + ratio;
+static const uint64_t POWERS_OF_10[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
 
-    size_t j = *out_size;
-    int64_t* temp = malloc(j * sizeof(int64_t));
-    
-    while(n > 0) {
-        temp[--j] = n % base;
-        n /= base;
+// the number of digits `n' has in `base', which is at least 2
+size_t digit_count(uint64_t n, uint64_t base) {
+    if(n == 0) {
+        return 1;
     }
-    
-    /*
-     * When there are spaces remaining, move all the elements backward
-     * TODO: find out how to fix bug concerning some powers of the base
-     * Replicate with:
-     * 
-     *    to_base(8, 2, &i) = { 0, 0, 0 }
-     *
-     */
-    if(j) {
-        *out_size -= j;
-        memmove(temp, temp + j, *out_size * sizeof(int64_t));
+    size_t bits = 64 - __builtin_clzll(n);
+    if(base == 10) {
+        // bits * log10(2) is the digit count, or one more than it
+        size_t guess = bits * 1233 >> 12;
+        return guess + (n >= POWERS_OF_10[guess]);
+    }
+    if((base & (base - 1)) == 0) {
+        size_t shift = __builtin_ctzll(base);
+        return (bits + shift - 1) / shift;
+    }
+    size_t count = 1;
+    // the smallest number with one more digit than `count'
+    uint64_t bound = base;
+    while(n >= bound) {
+        count++;
+        if(bound > UINT64_MAX / base) {
+            break;
+        }
+        bound *= base;
     }
-    
-    return temp;
+    return count;
 }
 
-void print_int(int64_t n) {
-    fflush(stdout);
-    
+/*
+ * Writes `n' in `base', 2 to 36, into `buf' without a terminator and gives
+ * its length, at most FORMAT_INT_SIZE - 1. The length is known up front, so
+ * the digits are written backward straight into place.
+ */
+size_t format_uint(char* buf, uint64_t n, unsigned base) {
+    size_t size = digit_count(n, base);
+    char* pos = buf + size;
+    if(base == 10) {
+        while(n >= 100) {
+            const char* pair = DIGIT_PAIRS + n % 100 * 2;
+            n /= 100;
+            *--pos = pair[1];
+            *--pos = pair[0];
+        }
+        if(n >= 10) {
+            *--pos = DIGIT_PAIRS[n * 2 + 1];
+            *--pos = DIGIT_PAIRS[n * 2];
+        }
+        else {
+            *--pos = '0' + n;
+        }
+    }
+    else if((base & (base - 1)) == 0) {
+        unsigned shift = __builtin_ctz(base);
+        do {
+            *--pos = ALPHABET[n & (base - 1)];
+            n >>= shift;
+        } while(n);
+    }
+    else {
+        do {
+            *--pos = ALPHABET[n % base];
+            n /= base;
+        } while(n);
+    }
+    return size;
+}
+
+// format_uint, with a leading - for negative numbers
+size_t format_int(char* buf, int64_t n, unsigned base) {
     if(n < 0) {
-        putchar('-');
-        print_int(-n);
+        buf[0] = '-';
+        return 1 + format_uint(buf + 1, -(uint64_t) n, base);
     }
-    
-    else if(OUTPUT_BASE == 1) {
-        fprintf(stderr, "unary isn't really a base...\n");
-        int64_t t = n;
-        char* temp = malloc(n * sizeof(char));
-        while(t --> 0) {
-            temp[t] = '1';
+    return format_uint(buf, n, base);
+}
+
+// pushes the digits of `n' in `base', most significant first; nothing for
+// n <= 0 or a base below 2
+void stack_push_digits(STACK* stk, int64_t n, int64_t base) {
+    if(n <= 0 || base < 2) {
+        return;
+    }
+    if(base <= 36) {
+        char buf[FORMAT_INT_SIZE];
+        size_t size = format_uint(buf, n, base);
+        for(size_t i = 0; i < size; i++) {
+            stack_push(stk, char_to_in_digit(buf[i]));
         }
-        write(1, temp, n);
-        free(temp);
+        return;
     }
-    
-    else if(n == 0 || n == 1) {
-        putchar('0' + n);
+    // digits too large for a character; base^13 > 2^63 for these
+    int64_t digits[13];
+    size_t size = digit_count(n, base);
+    for(size_t i = size; i-- > 0; n /= base) {
+        digits[i] = n % base;
     }
-    
-    // any number equal to the output base is represented as 10
-    else if(n == OUTPUT_BASE) {
-        printf("10");
+    stack_push_int_array(stk, digits, size);
+}
+
+void print_int(OML* inst, int64_t n) {
+    char buf[FORMAT_INT_SIZE];
+    if(inst->bigint && BIG_IS(n)) {
+        big_print(inst, n);
+        return;
+    }
+    if(2 <= inst->output_base && inst->output_base <= 36) {
+        out_write(inst->out, 1, buf, format_int(buf, n, inst->output_base));
+        return;
+    }
+
+    uint64_t u = n;
+    if(n < 0) {
+        out_char(inst->out, 1, '-');
+        u = -(uint64_t) n;
     }
     
-    else if(OUTPUT_BASE == 10) {
-        printf("%"PRId64, n);
+    if(inst->output_base == 1) {
+        out_printf(inst->out, 2, "unary isn't really a base...\n");
+        for(uint64_t t = u; t > 0; t--) {
+            out_char(inst->out, 1, '1');
+        }
     }
     
-    else if(OUTPUT_BASE == 16) {
-        printf("%"PRIx64, n);
+    else if(u == 0 || u == 1) {
+        out_char(inst->out, 1, '0' + u);
     }
     
-    else if(OUTPUT_BASE <= 36) {
-        size_t digit_count;
-        int64_t* digits = to_output_base(n, &digit_count);
-        char* temp = malloc(digit_count * sizeof(char));
-        for(size_t i = 0; i < digit_count; i++) {
-            temp[i] = ALPHABET[digits[i]];
-        }
-        write(1, temp, digit_count);
-        free(temp);
-        free(digits);
+    // any number equal to the output base is represented as 10
+    else if(u == (uint64_t) inst->output_base) {
+        out_write(inst->out, 1, "10", 2);
     }
     
     else {
-        eprintf("No output for base %i: %"PRId64, OUTPUT_BASE, n); 
+        out_printf(inst->out, 2, "No output for base %i: %"PRIu64, inst->output_base, u);
     }
-    
-    fflush(stdout);
 }
 
-int is_valid_in_char(int c) {
-    if(INPUT_BASE <= 10)
-        return '0' <= c && c < ALPHABET[INPUT_BASE];
+int is_valid_in_char(int c, int base) {
+    if(base <= 10)
+        return '0' <= c && c < ALPHABET[base];
     else
-        return '0' <= c && (c <= '9' || c < ALPHABET[INPUT_BASE]);
+        return '0' <= c && (c <= '9' || c < ALPHABET[base]);
 }
 
 int char_to_in_digit(int c) {
     return c <= '9' ? c - '0' : c - ALPHABET[10] + 10;
 }
 
-int64_t input_int(void) {
-    int64_t ret = 0;
-    
-    if(INPUT_BASE == 10) {
-        scanf(" %"SCNd64, &ret);
-    }
-    
-    else {
-        // fixed width is fine, since numbers can only be so long without loss
-        // of precision
-        char number_str[80] = {0};
-        // format should start with a space, to ensure that whitespace
-        // is consumed
-        char* format = malloc(14 * sizeof(char));
-        
-        // assume is negative until scanf fails
-        int sign = -1;
-        
-        if(INPUT_BASE < 9) {
-            strcpy(format, " -%[0-?]");
-            //              0123456
-            // update the question mark
-            format[6] = ALPHABET[INPUT_BASE-1];
-            // debug_printf("[[%s]]\n", format);
-        }
-        
-        else {
-            strcpy(format, " -%[0-9a-?A-?]");
-            //              0123456789ABCD
-            // update the two question marks; C = 12
-            format[9] = ALPHABET[INPUT_BASE-1];
-            format[12] = toupper(ALPHABET[INPUT_BASE-1]);
-        }
-        
-        // if the string did not start with a negative sign
-        if(scanf(format, &number_str) != 1) {
-            sign = 1;
-            // replace sign query with a space
-            format[1] = ' ';
-            // TODO: check when this format fails as well
-            scanf(format, &number_str);
-        }
-        
-        // TODO: maybe put the logic of base conversion in a function?
-        // Is there enough code to warrant that?
-        for(size_t pos = 0; number_str[pos]; pos++) {
-            ret *= INPUT_BASE;
-            ret += char_to_in_digit(number_str[pos]);
-        }
-        ret *= sign;
-        free(format);
-    }
-    return ret;
+// reads a number; under OML_set_bigint, one that would read as a big number
+// is made one
+int64_t input_int(OML* inst) {
+    int64_t n = in_int(inst->in, inst->input_base);
+    return inst->bigint ? big_from_int(inst, n) : n;
+}
+
+// reads a decimal number as an integer, giving in `prec' how many of its
+// digits follow the point
+int64_t input_decimal(OML* inst, int64_t* prec) {
+    double d = in_double(inst->in);
+    *prec = 0;
+    while(fpart(d)) {
+        d *= 10;
+        ++*prec;
+    }
+    return d;
 }
 
 double fpart(double d) {
@@ -426,809 +663,1928 @@ int64_t ipow(int64_t base, int64_t exp) {
     return result;
 }
 
-void OML_exec_cmd(OML* inst, char cur) {
-    STACK* res = &inst->stk;
-    
-    if(cur == ' ') {
-        // no-op, do nothing
-    }
-    else if(cur == '!') {
-        int64_t a = stack_pop(res);
-        stack_push(res, factorial(a));
-    }
-    else if(cur == '"') {
-        inst->i++;
-        size_t start = inst->i;
-        while(inst->i < inst->size) {
-            if(inst->code[inst->i] == '"') {
-                if(inst->i + 1 >= inst->size || inst->code[inst->i + 1] != '"') {
-                    break;
-                }
-            }
-            inst->i++;
-        }
-        size_t end = inst->i;
-        for(size_t j = end - 1; j >= start; --j) {
-            stack_push(res, inst->code[j]);
-        }
-        stack_push(res, end - start);
-    }
-    else if(cur == '#') {
-        print_int(stack_pop(res));
-    }
-    else if(cur == '$') {
-        stack_pop(res);
-    }
-    else if(cur == '%') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a % b);
-    }
-    else if(cur == '&') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a & b);
-    }
-    else if(cur == '\'') {
-        char c = inst->code[++inst->i];
-        stack_push(res, (int64_t)c);
-    }
-    else if(cur == '(') {
-        // if not tos, go to next )
-        if(!stack_peek(res)) {
-            int depth = 1;
-            while(depth) {
-                inst->i++;
-                if(inst->code[inst->i] == '(') {
-                    depth++;
-                }
-                else if(inst->code[inst->i] == ')') {
-                    depth--;
-                }
+// returns the index of the quote closing the string opened at `start`
+size_t OML_string_end(char* code, size_t size, size_t start) {
+    size_t i = start + 1;
+    while(i < size) {
+        if(code[i] == '"') {
+            if(i + 1 >= size || code[i + 1] != '"') {
+                break;
             }
         }
+        i++;
     }
-    else if(cur == ')') {
-        // if tos, go to previous (
-        if(stack_peek(res)) {
-            int depth = 1;
-            while(depth) {
-                inst->i--;
-                if(inst->code[inst->i] == '(') {
-                    depth--;
-                }
-                else if(inst->code[inst->i] == ')') {
-                    depth++;
-                }
-            }
+    return i;
+}
+
+// commands that take no operand, indexed by their character
+static const unsigned char OML_OPCODES[256] = {
+    ['!'] = OP_FACTORIAL,       ['#'] = OP_PRINT,           ['$'] = OP_DROP,
+    ['%'] = OP_MOD,             ['&'] = OP_AND,             ['*'] = OP_MUL,
+    ['+'] = OP_ADD,             [','] = OP_SWAP,            ['-'] = OP_SUB,
+    ['.'] = OP_DIVMOD,          ['/'] = OP_DIV,             [':'] = OP_DUP,
+    [';'] = OP_OVER,            ['<'] = OP_LT,              ['='] = OP_EQ,
+    ['>'] = OP_GT,              ['?'] = OP_RANDOM,          ['@'] = OP_ROT,
+    ['K'] = OP_DUP_N,           ['L'] = OP_CLEAR,           ['M'] = OP_CBRT,
+    ['N'] = OP_SQRT,            ['O'] = OP_DISPLAY,         ['P'] = OP_SET_IN_BASE,
+    ['Q'] = OP_SET_OUT_BASE,    ['R'] = OP_REVERSE_N,       ['T'] = OP_CONCAT,
+    ['U'] = OP_BITS,            ['V'] = OP_DIGITS,          ['W'] = OP_WRITE,
+    ['X'] = OP_TRIPLICATE,      ['Y'] = OP_RANGE,           ['Z'] = OP_TOP_TO_BOTTOM,
+    ['['] = OP_ENTER,           ['\\'] = OP_REVERSE,        [']'] = OP_LEAVE,
+    ['^'] = OP_XOR,             ['_'] = OP_NEGATE,          ['`'] = OP_POW,
+    ['a'] = OP_FLIP_BIT,        ['b'] = OP_COPY_NTH,        ['c'] = OP_MOVE_NTH,
+    ['d'] = OP_ISOLATE,         ['h'] = OP_INPUT_INT,       ['i'] = OP_INPUT_LINE,
+    ['j'] = OP_INPUT_CHAR,      ['l'] = OP_LENGTH,          ['m'] = OP_CUBE,
+    ['n'] = OP_SQUARE,          ['o'] = OP_PUT_CHAR,        ['p'] = OP_IN_BASE,
+    ['q'] = OP_OUT_BASE,        ['r'] = OP_DEPTH,           ['s'] = OP_PUT_STR,
+    ['u'] = OP_FROM_BINARY,     ['v'] = OP_FROM_BASE,       ['x'] = OP_REPEAT,
+    ['z'] = OP_BOTTOM_TO_TOP,   ['|'] = OP_OR,              ['~'] = OP_COMPLEMENT,
+    // commands reading the next character as a variable or register
+    ['f'] = OP_STORE_VAR,       ['g'] = OP_LOAD_VAR,
+    ['t'] = OP_REG_PUSH,        ['w'] = OP_REG_POP,
+};
+
+// extended commands, indexed by the character following `e'
+static const unsigned char OML_EXT_OPCODES[256] = {
+    ['!'] = OP_NOT,             ['#'] = OP_PRINT_LN,        ['%'] = OP_MOD_ALL,
+    ['*'] = OP_MUL_ALL,         ['+'] = OP_ADD_ALL,         ['-'] = OP_DIFFERENCES,
+    ['/'] = OP_SCAN,            ['<'] = OP_GE,              ['='] = OP_NE,
+    ['>'] = OP_LE,              ['?'] = OP_RANDOM_FILL,     ['A'] = OP_IS_ALPHA,
+    ['C'] = OP_TO_UPPER,        ['D'] = OP_PRINT_DECIMAL,   ['P'] = OP_IS_PRIME,
+    ['S'] = OP_SUM,             ['T'] = OP_STACK_STATS,     ['X'] = OP_PRODUCT,
+    ['['] = OP_MINIMUM,         [']'] = OP_MAXIMUM,         ['c'] = OP_TO_LOWER,
+    ['d'] = OP_INPUT_DECIMAL,   ['e'] = OP_STDIN_REMAINING, ['i'] = OP_INPUT_ALL,
+    ['m'] = OP_NEW_STACK,       ['n'] = OP_STACK_MOVE,      ['o'] = OP_STACK_DISPLAY,
+    ['p'] = OP_STACK_PUSH,      ['q'] = OP_STACK_POP,       ['~'] = OP_EXIT,
+};
+
+// reads the operand following the command at `*i`, or 0 past the end
+static char OML_operand(char* code, size_t size, size_t* i) {
+    return ++*i < size ? code[*i] : 0;
+}
+
+// commands with an effect beyond the stack they run on
+static const bool OML_IMPURE[OP_COUNT] = {
+    [OP_STORE_VAR] = true,      [OP_REG_PUSH] = true,       [OP_REG_POP] = true,
+    [OP_EXIT] = true,
+    [OP_PRINT] = true,          [OP_PRINT_LN] = true,       [OP_PRINT_DECIMAL] = true,
+    [OP_DISPLAY] = true,        [OP_PUT_CHAR] = true,       [OP_PUT_STR] = true,
+    [OP_WRITE] = true,          [OP_INPUT_INT] = true,      [OP_INPUT_LINE] = true,
+    [OP_INPUT_CHAR] = true,     [OP_INPUT_DECIMAL] = true,  [OP_INPUT_ALL] = true,
+    [OP_STDIN_REMAINING] = true,[OP_SET_IN_BASE] = true,    [OP_SET_OUT_BASE] = true,
+    [OP_NEW_STACK] = true,      [OP_STACK_MOVE] = true,     [OP_STACK_DISPLAY] = true,
+    [OP_STACK_PUSH] = true,     [OP_STACK_POP] = true,
+    // what a stack has cost depends on the thread a body runs on
+    [OP_STACK_STATS] = true,
+    // asked for too many, it leaves the run, which only the thread running
+    // the program can do
+    [OP_RANDOM_FILL] = true,
+    // big numbers are made in the memory of the instance
+    [OP_BIG_ADD] = true,        [OP_BIG_SUB] = true,        [OP_BIG_MUL] = true,
+    [OP_BIG_DIV] = true,        [OP_BIG_MOD] = true,        [OP_BIG_DIVMOD] = true,
+    [OP_BIG_NEGATE] = true,     [OP_BIG_POW] = true,        [OP_BIG_FACTORIAL] = true,
+    [OP_BIG_SQUARE] = true,     [OP_BIG_CUBE] = true,       [OP_BIG_CONCAT] = true,
+    [OP_BIG_VECTOR] = true,     [OP_BIG_WRAPPED] = true,
+};
+
+// commands drawing from the random stream, which a record of -n carries on
+// to the next
+static const bool OML_RANDOM[OP_COUNT] = {
+    [OP_RANDOM] = true,         [OP_RANDOM_FILL] = true,
+};
+
+// whether the instructions in [start, end) draw random numbers
+static bool OML_body_random(OML_PROGRAM* prog, size_t start, size_t end) {
+    for(size_t i = start; i < end; i++) {
+        if(OML_RANDOM[prog->instrs[i].op]) {
+            return true;
         }
     }
-    else if(cur == '*') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a * b);
-    }
-    else if(cur == '+') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a + b);
-    }
-    else if(cur == ',') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, b);
-        stack_push(res, a);
-    }
-    else if(cur == '-') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a - b);
-    }
-    else if(cur == '.') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a / b);
-        stack_push(res, a % b);
-    }
-    else if(cur == '/') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a / b);
+    return false;
+}
+
+// whether the instructions in [start, end) only read and write their stack
+static bool OML_body_pure(OML_PROGRAM* prog, size_t start, size_t end) {
+    for(size_t i = start; i < end; i++) {
+        if(OML_IMPURE[prog->instrs[i].op]) {
+            return false;
+        }
     }
-    else if(cur >= '0' && cur <= '9') {
-        stack_push(res, cur - '0');
-    }
-    else if(cur == ':') {
-        int64_t a = stack_pop(res);
-        stack_push(res, a);
-        stack_push(res, a);
-    }
-    else if(cur == ';') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a);
-        stack_push(res, b);
-        stack_push(res, a);
-    }
-    else if(cur == '<') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a < b);
-    }
-    else if(cur == '=') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a == b);
-    }
-    else if(cur == '>') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a > b);
-    }
-    else if(cur == '?') {
-        int64_t a = stack_pop(res);
-        stack_push(res, random_between(0, a));
-    }
-    else if(cur == '@') {
-        int64_t c = stack_pop(res);
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, c);
-        stack_push(res, a);
-        stack_push(res, b);
-    }
-    else if('A' <= cur && cur <= 'F') {
-        stack_push(res, cur - 'A' + 10);
-    }
-    else if(cur == 'G') {
-        stack_push(res, 64);
-    }
-    else if(cur == 'H') {
-        stack_push(res, 256);
-    }
-    else if(cur == 'I') {
-        stack_push(res, 100);
-    }
-    else if(cur == 'J') {
-        stack_push(res, 1000);
-    }
-    else if(cur == 'K') {
-        int64_t n = stack_pop(res);
-        int64_t c = n;
-        while(c --> 0) {
-            stack_push(res, res->data[res->size - n]);
-        }
-    }
-    else if(cur == 'L') {
-        stack_clear(res);
-    }
-    else if(cur == 'M') {
-        int64_t a = stack_pop(res);
-        stack_push(res, icbrt(a));
-    }
-    else if(cur == 'N') {
-        int64_t a = stack_pop(res);
-        stack_push(res, isqrt(a));
-    }
-    else if(cur == 'O') {
-        stack_display(*res);
-    }
-    else if(cur == 'P') {
-        INPUT_BASE = stack_pop(res);
-    }
-    else if(cur == 'Q') {
-        OUTPUT_BASE = stack_pop(res);
-    }
-    else if(cur == 'R') {
-        int64_t count = stack_pop(res);
-        STACK temp = stack_init();
-        for(int64_t i = 0; i < count; i++) {
-            stack_push(&temp, stack_pop(res));
-        }
-        for(int64_t i = 0; i < count; i++) {
-            stack_push(res, temp.data[i]);
-        }
-        stack_destroy(&temp);
-    }
-    else if(cur == 'S') {
-        stack_push(res, 16);
-    }
-    // digit concatenation rom https://stackoverflow.com/a/12700533/4119004
-    else if(cur == 'T') {
-        int64_t x, y, pow;
-        y = stack_pop(res);
-        x = stack_pop(res);
-        pow = 10;
-        while(y >= pow)
-            pow *= 10;
-        stack_push(res, x * pow + y);
-    }
-    else if(cur == 'U') {
-        int64_t n = stack_pop(res);
-        size_t bit_size;
-        int64_t* bits = to_base(n, 2, &bit_size);
-        stack_push_int_array(res, bits, bit_size);
-        free(bits);
-    }
-    else if(cur == 'V') {
-        int64_t n, *digits;
-        size_t digit_count;
-        n = stack_pop(res);
-        digits = to_output_base(n, &digit_count);
-        for(size_t i = 0; i < digit_count; i++) {
-            stack_push(res, digits[i]);
-        }
-        free(digits);
-    }
-    else if(cur == 'W') {
-        int64_t stream, count;
-        stream = stack_pop(res);
-        count = stack_pop(res);
-        char* temp = malloc(count * sizeof(char));
-        for(size_t i = 0; i < count; i++) {
-            temp[i] = stack_pop(res);
-        }
-        write(stream, temp, count);
-        free(temp);
-    }
-    else if(cur == 'X') {
-        int64_t x = stack_pop(res);
-        stack_push(res, x);
-        stack_push(res, x);
-        stack_push(res, x);
-    }
-    else if(cur == 'Y') {
-        int64_t n = stack_pop(res);
-        for(int64_t i = 0; i < n; i++) {
-            stack_push(res, i);
-        }
-    }
-    else if(cur == 'Z') {
-        int64_t top = stack_pop(res);
-        stack_unshift(res, top);
-    }
-    else if(cur == '[') {
-        int64_t count = stack_pop(res);
-        size_t size = res->size;
-        for(size_t i = 0; i < size - count; i++) {
-            stack_push(&inst->stk_stk, stack_shift(res));
-        }
-        stack_push(&inst->stk_stk, size - count);
-        inst->sub_stk_size++;
-    }
-    else if(cur == '\\') {
-        STACK temp = stack_init();
-        while(res->size) {
-            stack_push(&temp, stack_pop(res));
-        }
-        while(temp.size) {
-            stack_unshift(res, stack_pop(&temp));
-        }
-        stack_destroy(&temp);
-    }
-    else if(cur == ']') {
-        int64_t count = stack_pop(&inst->stk_stk);
-        while(count --> 0) {
-            stack_unshift(res, stack_pop(&inst->stk_stk));
-        }
-        inst->sub_stk_size--;
-    }
-    else if(cur == '^') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a ^ b);
-    }
-    else if(cur == '^') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a ^ b);
-    }
-    else if(cur == '_') {
-        int64_t a = stack_pop(res);
-        stack_push(res, -a);
-    }
-    else if(cur == '`') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, ipow(a, b));
-    }
-    else if(cur == 'a') {
-        int64_t k = stack_pop(res);
-        int64_t n = stack_pop(res);
-        stack_push(res, n ^ (1ull << k));
-    }
-    else if(cur == 'b') {
-        int64_t index = stack_pop(res);
-        index = res->size - index - 1;
-        stack_push(res, res->data[index]);
-    }
-    else if(cur == 'c') {
-        int64_t index = stack_pop(res);
-        index = res->size - index - 1;
-        int64_t entry = stack_pop_from(res, index);
-        stack_push(res, entry);
-    }
-    else if(cur == 'd') {
-        int64_t top = stack_pop(res);
-        res->size = 0;
-        stack_push(res, top);
-    }
-    else if(cur == 'f') {
-        unsigned char ident = inst->code[++inst->i];
-        inst->vars[ident] = stack_pop(res);
-    }
-    else if(cur == 'g') {
-        unsigned char ident = inst->code[++inst->i];
-        stack_push(res, inst->vars[ident]);
-    }
-    else if(cur == 'h') {
-        stack_push(res, input_int());
-    }
-    // read line
-    else if(cur == 'i') {
-        int c = 1;
-        size_t size = 0;
-        while((c = getchar()) != 10 && c != EOF) {
-            stack_push(res, c);
-            size++;
+    return true;
+}
+
+/*
+ * Compiles the program into a stream of instructions with their operands
+ * decoded: literals become a single push, registers and variables carry their
+ * index, and every bracket carries the index of the instruction to continue
+ * at. No-ops and comments produce no instruction. The body of an `e(` or `e{`
+ * directly follows it in the stream, and ends at its target.
+ */
+OML_PROGRAM OML_compile(char* code, size_t size) {
+    OML_PROGRAM prog;
+    prog.instrs = malloc((size + 1) * sizeof(OML_INSTR));
+    prog.size = 0;
+
+    size_t* parens = malloc((size + 1) * sizeof(size_t));
+    size_t* blocks = malloc((size + 1) * sizeof(size_t));
+    // paren depth at the time each block was opened, or SIZE_MAX for `{`
+    size_t* scopes = malloc((size + 1) * sizeof(size_t));
+    size_t paren_depth = 0, block_depth = 0;
+
+    for(size_t i = 0; i < size; i++) {
+        char cur = code[i];
+        OML_INSTR instr = { OP_NOP, i, 0, 0, NULL };
+
+        if(cur >= '0' && cur <= '9') {
+            instr.op = OP_PUSH;
+            instr.value = cur - '0';
         }
-        if(c == 10) {
-            size++;
-            stack_push(res, c);
+        else if('A' <= cur && cur <= 'F') {
+            instr.op = OP_PUSH;
+            instr.value = cur - 'A' + 10;
         }
-        stack_push(res, size);
-        OML_exec_cmd(inst, 'R');
-        stack_push(res, size);
-    }
-    else if(cur == 'j') {
-        stack_push(res, getchar());
-    }
-    
-    else if(cur == 'l') {
-        stack_push(res, res->size);
-    }
-    
-    else if(cur == 'm') {
-        int64_t n = stack_pop(res);
-        stack_push(res, n * n * n);
-    }
-    
-    else if(cur == 'n') {
-        int64_t n = stack_pop(res);
-        stack_push(res, n * n);
-    }
-    
-    else if(cur == 'o') {
-        int64_t a = stack_pop(res);
-        putchar((char) a);
-    }
-    
-    else if(cur == 'p') {
-        stack_push(res, INPUT_BASE);
-    }
-    
-    else if(cur == 'q') {
-        stack_push(res, OUTPUT_BASE);
-    }
-    
-    else if(cur == 'r') {
-        stack_push(res, inst->sub_stk_size);
-    }
-    
-    else if(cur == 's') {
-        size_t size = stack_pop(res);
-        char* str = malloc(size * sizeof(char));
-        for(size_t i = 0; i < size; i++) {
-            str[i] = (char)stack_pop(res);
+        else if(cur == 'G' || cur == 'H' || cur == 'I' || cur == 'J' || cur == 'S') {
+            instr.op = OP_PUSH;
+            instr.value = cur == 'G' ? 64
+                        : cur == 'H' ? 256
+                        : cur == 'I' ? 100
+                        : cur == 'J' ? 1000
+                        : 16;
         }
-        fflush(stdout);
-        write(1, str, size);
-        free(str);
-    }
-    
-    else if(cur == 't') {
-        unsigned char ident = inst->code[++inst->i];
-        STACK* reg = &inst->reg_stk[ident];
-        stack_push(reg, stack_pop(res));
-    }
-    
-    else if(cur == 'u') {
-        int64_t sum = 0;
-        size_t pos = 0;
-        while(pos < res->size) {
-            sum <<= 1;
-            sum += res->data[pos];
-            pos++;
-        }
-        res->size = 0;
-        stack_push(res, sum);
-    }
-    else if(cur == 'v') {
-        int64_t sum = 0;
-        size_t pos = 0;
-        while(pos < res->size) {
-            sum *= OUTPUT_BASE;
-            sum += res->data[pos];
-            pos++;
-        }
-        res->size = 0;
-        stack_push(res, sum);
-    }
-    else if(cur == 'w') {
-        unsigned char ident = inst->code[++inst->i];
-        STACK* reg = &inst->reg_stk[ident];
-        stack_push(res, stack_pop(reg));
-    }
-    else if(cur == 'x') {
-        int64_t repeater = stack_pop(res);
-        int64_t repetend = stack_pop(res);
-        while(repeater --> 0) {
-            stack_push(res, repetend);
+        else if(cur == '\'') {
+            instr.op = OP_PUSH;
+            instr.value = OML_operand(code, size, &i);
         }
-    }
-    
-    else if(cur == 'z') {
-        int64_t bot = stack_shift(res);
-        stack_push(res, bot);
-    }
-    
-    else if(cur == '{') {
-        if(!stack_pop(res)) {
-            int depth = 1;
-            while(depth) {
-                inst->i++;
-                if(inst->code[inst->i] == '{') {
-                    depth++;
+        else if(cur == '"') {
+            size_t end = OML_string_end(code, size, i);
+            instr.op = OP_STRING;
+            instr.str = code + i + 1;
+            instr.value = end - i - 1;
+            i = end;
+        }
+        else if(cur == 'f' || cur == 'g' || cur == 't' || cur == 'w') {
+            instr.op = OML_OPCODES[(unsigned char) cur];
+            instr.value = (unsigned char) OML_operand(code, size, &i);
+        }
+        else if(cur == '(') {
+            instr.op = OP_WHILE;
+            parens[paren_depth++] = prog.size;
+        }
+        else if(cur == ')') {
+            instr.op = OP_END_WHILE;
+            instr.target = prog.size + 1;
+            if(paren_depth) {
+                size_t open = parens[--paren_depth];
+                prog.instrs[open].target = prog.size + 1;
+                instr.target = open + 1;
+            }
+        }
+        else if(cur == '{') {
+            instr.op = OP_IF;
+            scopes[block_depth] = SIZE_MAX;
+            blocks[block_depth++] = prog.size;
+        }
+        else if(cur == '}') {
+            if(block_depth) {
+                size_t open = blocks[--block_depth];
+                prog.instrs[open].target = prog.size;
+                // loops left open inside a body end with the body
+                if(scopes[block_depth] != SIZE_MAX) {
+                    while(paren_depth > scopes[block_depth]) {
+                        prog.instrs[parens[--paren_depth]].target = prog.size;
+                    }
                 }
-                else if(inst->code[inst->i] == '}') {
-                    depth--;
+            }
+        }
+        else if(cur == 'e' && i + 1 < size) {
+            char ident = code[++i];
+            if(ident == '(' || ident == '{') {
+                instr.op = ident == '(' ? OP_REDUCE : OP_MAP;
+                scopes[block_depth] = paren_depth;
+                blocks[block_depth++] = prog.size;
+            }
+            else if(ident == '\\') {
+                while(i < size && code[i] != '\n') {
+                    i++;
                 }
             }
+            else {
+                instr.op = OML_EXT_OPCODES[(unsigned char) ident];
+            }
+            instr.src = i - 1;
+        }
+        else {
+            instr.op = OML_OPCODES[(unsigned char) cur];
+        }
+
+        if(instr.op != OP_NOP) {
+            prog.instrs[prog.size++] = instr;
         }
     }
-    else if(cur == '|') {
-        int64_t b = stack_pop(res);
-        int64_t a = stack_pop(res);
-        stack_push(res, a | b);
+
+    while(paren_depth) {
+        prog.instrs[parens[--paren_depth]].target = prog.size;
     }
-    
-    else if(cur == '~') {
-        int64_t a = stack_pop(res);
-        stack_push(res, ~a);
+    while(block_depth) {
+        prog.instrs[blocks[--block_depth]].target = prog.size;
     }
-    
-    // extended function6
-    else if(cur == 'e') {
-        unsigned char ident = inst->code[++inst->i];
-        if(ident == '!') {
-            int64_t a = stack_pop(res);
-            stack_push(res, !a);
+    for(size_t i = 0; i < prog.size; i++) {
+        if(prog.instrs[i].op == OP_MAP) {
+            prog.instrs[i].value = OML_body_pure(&prog, i + 1, prog.instrs[i].target);
         }
-        else if(ident == '#') {
-            int64_t a = stack_pop(res);
-            print_int(a);
-            puts("");
+    }
+
+    free(parens);
+    free(blocks);
+    free(scopes);
+
+    return prog;
+}
+
+// folds an operator applied to two literals, if that is always safe
+static bool OML_fold_binary(int op, int64_t a, int64_t b, int64_t* out) {
+    // wrap around like the run-time operators do in practice
+    uint64_t x = a, y = b;
+    if(op == OP_ADD)        *out = x + y;
+    else if(op == OP_SUB)   *out = x - y;
+    else if(op == OP_MUL)   *out = x * y;
+    else if(op == OP_AND)   *out = a & b;
+    else if(op == OP_OR)    *out = a | b;
+    else if(op == OP_XOR)   *out = a ^ b;
+    else if(op == OP_LT)    *out = a < b;
+    else if(op == OP_EQ)    *out = a == b;
+    else if(op == OP_GT)    *out = a > b;
+    else if(op == OP_GE)    *out = a >= b;
+    else if(op == OP_NE)    *out = a != b;
+    else if(op == OP_LE)    *out = a <= b;
+    // leave faults and endless loops to run time
+    else if(op == OP_POW && b >= 0)
+        *out = ipow(a, b);
+    else if(op == OP_FLIP_BIT && b >= 0 && b < 64)
+        *out = a ^ (1ull << b);
+    else if((op == OP_DIV || op == OP_MOD) && b != 0 && !(a == INT64_MIN && b == -1))
+        *out = op == OP_DIV ? a / b : a % b;
+    else
+        return false;
+    return true;
+}
+
+// folds an operator applied to a literal, if that is always safe
+static bool OML_fold_unary(int op, int64_t a, int64_t* out) {
+    uint64_t x = a;
+    if(op == OP_NEGATE)             *out = -x;
+    else if(op == OP_COMPLEMENT)    *out = ~a;
+    else if(op == OP_NOT)           *out = !a;
+    else if(op == OP_SQUARE)        *out = x * x;
+    else if(op == OP_CUBE)          *out = x * x * x;
+    else if(op == OP_SQRT)          *out = isqrt(a);
+    else if(op == OP_CBRT)          *out = icbrt(a);
+    else if(op == OP_FACTORIAL && a <= 1000)
+        *out = factorial(a);
+    else
+        return false;
+    return true;
+}
+
+/*
+ * Peephole pass over a compiled program. Operators applied to literals are
+ * folded into a single push, and common pairs are fused into
+ * superinstructions:
+ *
+ *     k+  k-    => OP_ADD_IMM        :*  => OP_SQUARE
+ *     k*        => OP_MUL_IMM        ,$  => OP_NIP
+ *     k%        => OP_MOD_IMM
+ *
+ * Only the first instruction of a fused group may be a jump target, so every
+ * path through the program sees the same stack effects as before. Stack
+ * underflow still reads zeroes, since every fused operator pops exactly as
+ * many values as the instructions it replaces.
+ */
+void OML_optimize(OML_PROGRAM* prog) {
+    OML_INSTR* instrs = prog->instrs;
+    size_t size = prog->size;
+    bool* is_target = calloc(size + 1, sizeof(bool));
+    // whether the output instruction at an index starts at a jump target
+    bool* barrier = calloc(size + 1, sizeof(bool));
+    size_t* map = malloc((size + 1) * sizeof(size_t));
+
+    for(size_t i = 0; i < size; i++) {
+        int op = instrs[i].op;
+        if(op == OP_WHILE || op == OP_END_WHILE || op == OP_IF) {
+            is_target[instrs[i].target] = true;
         }
-        // reduce (un-tested)
-        else if(ident == '(') {
-            size_t start = inst->i + 1, end = start;
-            // find end-point
-            int depth = 1;
-            while(depth && end < inst->size) {
-                if(inst->code[end] == '{')
-                    depth++;
-                else if(inst->code[end] == '}')
-                    depth--;
-                end++;
-            }
-            end--;
-            size_t res_size = end - start;
-            char* to_exec = malloc(res_size + 1);
-            to_exec[res_size] = '\0';
-            memcpy(to_exec, inst->code + start, res_size * sizeof(char));
-            
-            while(res->size != 1) {
-                STACK tmp = stack_from(*res);
-                res->size = 0;
-                OML_exec_str_stk(inst, to_exec, tmp);
-            }
-            
-            inst->i = end;
+        else if(op == OP_MAP || op == OP_REDUCE) {
+            is_target[i + 1] = true;
+            is_target[instrs[i].target] = true;
         }
-        else if(ident == '<') {
-            int64_t b = stack_pop(res);
-            int64_t a = stack_pop(res);
-            stack_push(res, a >= b);
+    }
+
+    // rewrite in place; the output never overtakes the input
+    size_t out = 0;
+    for(size_t i = 0; i < size; i++) {
+        OML_INSTR cur = instrs[i];
+        OML_INSTR* last = out >= 1 && !is_target[i] ? &instrs[out - 1] : NULL;
+        OML_INSTR* prev = out >= 2 && last && !barrier[out - 1] ? &instrs[out - 2] : NULL;
+        int64_t value;
+
+        if(prev && prev->op == OP_PUSH && last->op == OP_PUSH
+        && OML_fold_binary(cur.op, prev->value, last->value, &value)) {
+            prev->value = value;
+            out--;
         }
-        else if(ident == '=') {
-            int64_t b = stack_pop(res);
-            int64_t a = stack_pop(res);
-            stack_push(res, a != b);
+        else if(last && last->op == OP_PUSH && OML_fold_unary(cur.op, last->value, &value)) {
+            last->value = value;
         }
-        else if(ident == '>') {
-            int64_t b = stack_pop(res);
-            int64_t a = stack_pop(res);
-            stack_push(res, a <= b);
+        else if(last && last->op == OP_PUSH && (cur.op == OP_ADD || cur.op == OP_SUB)) {
+            last->op = OP_ADD_IMM;
+            if(cur.op == OP_SUB) {
+                last->value = -(uint64_t) last->value;
+            }
+            // 1+1+ => 2+
+            if(prev && prev->op == OP_ADD_IMM) {
+                prev->value = (uint64_t) prev->value + last->value;
+                out--;
+            }
         }
-        else if(ident == '\\') {
-            while(inst->i < inst->size && inst->code[inst->i] != '\n') {
-                inst->i++;
+        else if(last && last->op == OP_PUSH && cur.op == OP_MUL) {
+            last->op = OP_MUL_IMM;
+            if(prev && prev->op == OP_MUL_IMM) {
+                prev->value = (uint64_t) prev->value * last->value;
+                out--;
             }
         }
-        else if(ident == 'A') {
-            int64_t n = stack_pop(res);
-            stack_push(res, isalpha(n) != 0);
+        else if(last && last->op == OP_PUSH && cur.op == OP_MOD && last->value != 0) {
+            last->op = OP_MOD_IMM;
         }
-        else if(ident == 'C') {
-            int64_t n = stack_pop(res);
-            stack_push(res, toupper(n));
+        else if(last && last->op == OP_DUP && cur.op == OP_MUL) {
+            last->op = OP_SQUARE;
         }
-        else if(ident == 'D') {
-            int64_t n = stack_pop(res);
-            int64_t num = stack_pop(res);
-            double divisor = 1;
-            while(n --> 0) {
-                divisor *= 10;
-            }
-            printf("%g", num / divisor);
+        else if(last && last->op == OP_SWAP && cur.op == OP_DROP) {
+            last->op = OP_NIP;
         }
-        else if(ident == 'c') {
+        else {
+            barrier[out] = is_target[i];
+            instrs[out++] = cur;
+        }
+        map[i] = out - 1;
+    }
+    map[size] = out;
+
+    for(size_t i = 0; i < out; i++) {
+        int op = instrs[i].op;
+        if(op == OP_WHILE || op == OP_END_WHILE || op == OP_IF
+        || op == OP_MAP || op == OP_REDUCE) {
+            instrs[i].target = map[instrs[i].target];
+        }
+    }
+    prog->size = out;
+
+    free(is_target);
+    free(barrier);
+    free(map);
+}
+
+/*
+ * Runs the `e(' or `e{' at `pc' over the current stack without interpreting
+ * its body, if the body is simple enough: a single arithmetic command is the
+ * whole-stack command doing the same, and with the JIT other straight-line
+ * bodies compile to a native loop. Either gives what running the body would.
+ * Returns whether it ran.
+ */
+static bool OML_body_kernel(OML* inst, size_t pc) {
+    OML_INSTR* instr = &inst->prog.instrs[pc];
+    STACK* stk = &inst->stk;
+    // on an empty stack, a reduce still runs its body once
+    if(instr->target == pc + 2 && stk->size) {
+        OML_INSTR* body = instr + 1;
+        if(instr->op == OP_MAP && body->op == OP_ADD_IMM) {
+            stack_add_all(stk, body->value);
+            return true;
+        }
+        if(instr->op == OP_MAP && body->op == OP_MUL_IMM) {
+            stack_mul_all(stk, body->value);
+            return true;
+        }
+        if(instr->op == OP_MAP && body->op == OP_MOD_IMM) {
+            stack_mod_all(stk, body->value);
+            return true;
+        }
+        if(instr->op == OP_REDUCE && (body->op == OP_ADD || body->op == OP_MUL)) {
+            int64_t n = body->op == OP_ADD ? stack_sum(stk) : stack_product(stk);
+            stack_clear(stk);
+            stack_push(stk, n);
+            return true;
+        }
+    }
+    return inst->jit && OML_jit_body(inst, pc);
+}
+
+/*
+ * Instructions are dispatched through a dense table. Compilers supporting
+ * labels as values get a threaded loop, where every handler jumps directly
+ * to the handler of the next instruction; others use a switch. Defining
+ * OML_SWITCH_DISPATCH forces the switch. A profiled instance dispatches
+ * through a second table, which sends every instruction to the profiler
+ * before its handler, so that others pay nothing for profiling.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(OML_SWITCH_DISPATCH)
+    #define OML_THREADED_DISPATCH
+#endif
+
+#ifdef OML_THREADED_DISPATCH
+    #define CASE(op)    L_##op:
+    #define DISPATCH()  if(pc >= end) goto done; instr = &instrs[pc]; goto *table[instr->op]
+#else
+    #define CASE(op)    case op:
+    #define DISPATCH()  continue
+#endif
+#define NEXT            { pc++; DISPATCH(); }
+#define JUMP(t)         { pc = (t); DISPATCH(); }
+
+// runs the instructions in [start, end) of the current program
+void OML_run_range(OML* inst, size_t start, size_t end) {
+    STACK* res = &inst->stk;
+    OML_INSTR* instrs = inst->prog.instrs;
+    OML_INSTR* instr;
+    size_t pc = start;
+
+#ifdef OML_THREADED_DISPATCH
+    static void* labels[OP_COUNT] = {
+        [OP_NOP] = &&L_OP_NOP,                       [OP_PUSH] = &&L_OP_PUSH,
+        [OP_STRING] = &&L_OP_STRING,                 [OP_STORE_VAR] = &&L_OP_STORE_VAR,
+        [OP_LOAD_VAR] = &&L_OP_LOAD_VAR,             [OP_REG_PUSH] = &&L_OP_REG_PUSH,
+        [OP_REG_POP] = &&L_OP_REG_POP,               [OP_WHILE] = &&L_OP_WHILE,
+        [OP_END_WHILE] = &&L_OP_END_WHILE,           [OP_IF] = &&L_OP_IF,
+        [OP_REDUCE] = &&L_OP_REDUCE,                 [OP_MAP] = &&L_OP_MAP,
+        [OP_EXIT] = &&L_OP_EXIT,                     [OP_ADD] = &&L_OP_ADD,
+        [OP_SUB] = &&L_OP_SUB,                       [OP_MUL] = &&L_OP_MUL,
+        [OP_DIV] = &&L_OP_DIV,                       [OP_MOD] = &&L_OP_MOD,
+        [OP_DIVMOD] = &&L_OP_DIVMOD,                 [OP_NEGATE] = &&L_OP_NEGATE,
+        [OP_POW] = &&L_OP_POW,                       [OP_FACTORIAL] = &&L_OP_FACTORIAL,
+        [OP_SQUARE] = &&L_OP_SQUARE,                 [OP_CUBE] = &&L_OP_CUBE,
+        [OP_SQRT] = &&L_OP_SQRT,                     [OP_CBRT] = &&L_OP_CBRT,
+        [OP_CONCAT] = &&L_OP_CONCAT,                 [OP_RANDOM] = &&L_OP_RANDOM,
+        [OP_RANDOM_FILL] = &&L_OP_RANDOM_FILL,       [OP_IS_PRIME] = &&L_OP_IS_PRIME,
+        [OP_AND] = &&L_OP_AND,                       [OP_OR] = &&L_OP_OR,
+        [OP_XOR] = &&L_OP_XOR,                       [OP_COMPLEMENT] = &&L_OP_COMPLEMENT,
+        [OP_FLIP_BIT] = &&L_OP_FLIP_BIT,             [OP_NOT] = &&L_OP_NOT,
+        [OP_LT] = &&L_OP_LT,                         [OP_EQ] = &&L_OP_EQ,
+        [OP_GT] = &&L_OP_GT,                         [OP_GE] = &&L_OP_GE,
+        [OP_NE] = &&L_OP_NE,                         [OP_LE] = &&L_OP_LE,
+        [OP_DROP] = &&L_OP_DROP,                     [OP_DUP] = &&L_OP_DUP,
+        [OP_SWAP] = &&L_OP_SWAP,                     [OP_OVER] = &&L_OP_OVER,
+        [OP_ROT] = &&L_OP_ROT,                       [OP_TRIPLICATE] = &&L_OP_TRIPLICATE,
+        [OP_DUP_N] = &&L_OP_DUP_N,                   [OP_CLEAR] = &&L_OP_CLEAR,
+        [OP_REVERSE] = &&L_OP_REVERSE,               [OP_REVERSE_N] = &&L_OP_REVERSE_N,
+        [OP_RANGE] = &&L_OP_RANGE,                   [OP_REPEAT] = &&L_OP_REPEAT,
+        [OP_ISOLATE] = &&L_OP_ISOLATE,               [OP_COPY_NTH] = &&L_OP_COPY_NTH,
+        [OP_MOVE_NTH] = &&L_OP_MOVE_NTH,             [OP_TOP_TO_BOTTOM] = &&L_OP_TOP_TO_BOTTOM,
+        [OP_BOTTOM_TO_TOP] = &&L_OP_BOTTOM_TO_TOP,   [OP_LENGTH] = &&L_OP_LENGTH,
+        [OP_BITS] = &&L_OP_BITS,                     [OP_DIGITS] = &&L_OP_DIGITS,
+        [OP_FROM_BINARY] = &&L_OP_FROM_BINARY,       [OP_FROM_BASE] = &&L_OP_FROM_BASE,
+        [OP_ENTER] = &&L_OP_ENTER,                   [OP_LEAVE] = &&L_OP_LEAVE,
+        [OP_DEPTH] = &&L_OP_DEPTH,                   [OP_PRINT] = &&L_OP_PRINT,
+        [OP_PRINT_LN] = &&L_OP_PRINT_LN,             [OP_PRINT_DECIMAL] = &&L_OP_PRINT_DECIMAL,
+        [OP_DISPLAY] = &&L_OP_DISPLAY,               [OP_PUT_CHAR] = &&L_OP_PUT_CHAR,
+        [OP_PUT_STR] = &&L_OP_PUT_STR,               [OP_WRITE] = &&L_OP_WRITE,
+        [OP_INPUT_INT] = &&L_OP_INPUT_INT,           [OP_INPUT_LINE] = &&L_OP_INPUT_LINE,
+        [OP_INPUT_CHAR] = &&L_OP_INPUT_CHAR,         [OP_INPUT_DECIMAL] = &&L_OP_INPUT_DECIMAL,
+        [OP_INPUT_ALL] = &&L_OP_INPUT_ALL,           [OP_STDIN_REMAINING] = &&L_OP_STDIN_REMAINING,
+        [OP_SET_IN_BASE] = &&L_OP_SET_IN_BASE,       [OP_SET_OUT_BASE] = &&L_OP_SET_OUT_BASE,
+        [OP_IN_BASE] = &&L_OP_IN_BASE,               [OP_OUT_BASE] = &&L_OP_OUT_BASE,
+        [OP_IS_ALPHA] = &&L_OP_IS_ALPHA,             [OP_TO_UPPER] = &&L_OP_TO_UPPER,
+        [OP_TO_LOWER] = &&L_OP_TO_LOWER,             [OP_NEW_STACK] = &&L_OP_NEW_STACK,
+        [OP_STACK_MOVE] = &&L_OP_STACK_MOVE,         [OP_STACK_DISPLAY] = &&L_OP_STACK_DISPLAY,
+        [OP_STACK_PUSH] = &&L_OP_STACK_PUSH,         [OP_STACK_POP] = &&L_OP_STACK_POP,
+        [OP_ADD_ALL] = &&L_OP_ADD_ALL,               [OP_MUL_ALL] = &&L_OP_MUL_ALL,
+        [OP_MOD_ALL] = &&L_OP_MOD_ALL,               [OP_SUM] = &&L_OP_SUM,
+        [OP_PRODUCT] = &&L_OP_PRODUCT,               [OP_MINIMUM] = &&L_OP_MINIMUM,
+        [OP_MAXIMUM] = &&L_OP_MAXIMUM,               [OP_SCAN] = &&L_OP_SCAN,
+        [OP_DIFFERENCES] = &&L_OP_DIFFERENCES,
+        [OP_ADD_IMM] = &&L_OP_ADD_IMM,               [OP_MUL_IMM] = &&L_OP_MUL_IMM,
+        [OP_MOD_IMM] = &&L_OP_MOD_IMM,               [OP_NIP] = &&L_OP_NIP,
+        [OP_BIG_ADD] = &&L_OP_BIG_ADD,               [OP_BIG_SUB] = &&L_OP_BIG_SUB,
+        [OP_BIG_MUL] = &&L_OP_BIG_MUL,               [OP_BIG_DIV] = &&L_OP_BIG_DIV,
+        [OP_BIG_MOD] = &&L_OP_BIG_MOD,               [OP_BIG_DIVMOD] = &&L_OP_BIG_DIVMOD,
+        [OP_BIG_NEGATE] = &&L_OP_BIG_NEGATE,         [OP_BIG_POW] = &&L_OP_BIG_POW,
+        [OP_BIG_FACTORIAL] = &&L_OP_BIG_FACTORIAL,   [OP_BIG_SQUARE] = &&L_OP_BIG_SQUARE,
+        [OP_BIG_CUBE] = &&L_OP_BIG_CUBE,             [OP_BIG_CONCAT] = &&L_OP_BIG_CONCAT,
+        [OP_BIG_LT] = &&L_OP_BIG_LT,                 [OP_BIG_EQ] = &&L_OP_BIG_EQ,
+        [OP_BIG_GT] = &&L_OP_BIG_GT,                 [OP_BIG_GE] = &&L_OP_BIG_GE,
+        [OP_BIG_NE] = &&L_OP_BIG_NE,                 [OP_BIG_LE] = &&L_OP_BIG_LE,
+        [OP_BIG_VECTOR] = &&L_OP_BIG_VECTOR,         [OP_BIG_WRAPPED] = &&L_OP_BIG_WRAPPED,
+        [OP_STACK_STATS] = &&L_OP_STACK_STATS,
+    };
+    static void* profiled[OP_COUNT] = { [0 ... OP_COUNT - 1] = &&L_PROFILE };
+    void** table = inst->profile ? profiled : labels;
+
+    DISPATCH();
+    {
+    L_PROFILE:
+        OML_profile_tick(inst->profile, pc);
+        goto *labels[instr->op];
+#else
+    while(pc < end) {
+        instr = &instrs[pc];
+        if(inst->profile) {
+            OML_profile_tick(inst->profile, pc);
+        }
+        switch(instr->op) {
+#endif
+        CASE(OP_NOP) {
+            // no-op, do nothing
+            NEXT;
+        }
+        CASE(OP_PUSH) {
+            stack_push(res, instr->value);
+            NEXT;
+        }
+        CASE(OP_FACTORIAL) {
+            int64_t a = stack_pop(res);
+            stack_push(res, factorial(a));
+            NEXT;
+        }
+        CASE(OP_STRING) {
+            for(size_t j = instr->value; j > 0; --j) {
+                stack_push(res, instr->str[j - 1]);
+            }
+            stack_push(res, instr->value);
+            NEXT;
+        }
+        CASE(OP_PRINT) {
+            print_int(inst, stack_pop(res));
+            NEXT;
+        }
+        CASE(OP_DROP) {
+            stack_pop(res);
+            NEXT;
+        }
+        CASE(OP_MOD) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a % b);
+            NEXT;
+        }
+        CASE(OP_AND) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a & b);
+            NEXT;
+        }
+        CASE(OP_WHILE) {
+            // if not tos, go past the matching )
+            if(!stack_peek(res)) {
+                JUMP(instr->target);
+            }
+            NEXT;
+        }
+        CASE(OP_END_WHILE) {
+            // if tos, go back past the matching (
+            if(stack_peek(res)) {
+                if(inst->jit && OML_jit_loop(inst, pc) == JIT_LOOP_DONE) {
+                    NEXT;
+                }
+                JUMP(instr->target);
+            }
+            NEXT;
+        }
+        CASE(OP_MUL) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a * b);
+            NEXT;
+        }
+        CASE(OP_ADD) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a + b);
+            NEXT;
+        }
+        CASE(OP_SWAP) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, b);
+            stack_push(res, a);
+            NEXT;
+        }
+        CASE(OP_SUB) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a - b);
+            NEXT;
+        }
+        CASE(OP_DIVMOD) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a / b);
+            stack_push(res, a % b);
+            NEXT;
+        }
+        CASE(OP_DIV) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a / b);
+            NEXT;
+        }
+        CASE(OP_DUP) {
+            int64_t a = stack_pop(res);
+            stack_push(res, a);
+            stack_push(res, a);
+            NEXT;
+        }
+        CASE(OP_OVER) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a);
+            stack_push(res, b);
+            stack_push(res, a);
+            NEXT;
+        }
+        CASE(OP_LT) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a < b);
+            NEXT;
+        }
+        CASE(OP_EQ) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a == b);
+            NEXT;
+        }
+        CASE(OP_GT) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a > b);
+            NEXT;
+        }
+        CASE(OP_RANDOM) {
+            int64_t a = stack_pop(res);
+            stack_push(res, random_int(inst, a));
+            NEXT;
+        }
+        CASE(OP_IS_PRIME) {
             int64_t n = stack_pop(res);
-            stack_push(res, tolower(n));
+            stack_push(res, is_prime(n));
+            NEXT;
+        }
+        CASE(OP_RANDOM_FILL) {
+            int64_t count = stack_pop(res);
+            int64_t bound = stack_pop(res);
+            random_fill(inst, res, count, bound);
+            NEXT;
+        }
+        CASE(OP_ADD_ALL) {
+            int64_t k = stack_pop(res);
+            stack_add_all(res, k);
+            NEXT;
+        }
+        CASE(OP_MUL_ALL) {
+            int64_t k = stack_pop(res);
+            stack_mul_all(res, k);
+            NEXT;
+        }
+        CASE(OP_MOD_ALL) {
+            int64_t k = stack_pop(res);
+            stack_mod_all(res, k);
+            NEXT;
+        }
+        CASE(OP_SUM) {
+            int64_t n = stack_sum(res);
+            stack_clear(res);
+            stack_push(res, n);
+            NEXT;
+        }
+        CASE(OP_PRODUCT) {
+            int64_t n = stack_product(res);
+            stack_clear(res);
+            stack_push(res, n);
+            NEXT;
+        }
+        CASE(OP_MINIMUM) {
+            int64_t n = stack_min(res);
+            stack_clear(res);
+            stack_push(res, n);
+            NEXT;
+        }
+        CASE(OP_MAXIMUM) {
+            int64_t n = stack_max(res);
+            stack_clear(res);
+            stack_push(res, n);
+            NEXT;
         }
-        else if(ident == 'd') {
-            double d;
-            scanf(" %lf", &d);
-            int64_t prec = 0;
-            while(fpart(d)) {
-                d *= 10;
-                prec++;
+        CASE(OP_SCAN) {
+            stack_scan(res);
+            NEXT;
+        }
+        CASE(OP_DIFFERENCES) {
+            stack_differences(res);
+            NEXT;
+        }
+        CASE(OP_ROT) {
+            int64_t c = stack_pop(res);
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, c);
+            stack_push(res, a);
+            stack_push(res, b);
+            NEXT;
+        }
+        CASE(OP_DUP_N) {
+            int64_t n = stack_pop(res);
+            int64_t c = n;
+            while(c --> 0) {
+                stack_push(res, STACK_AT(res, res->size - n));
             }
-            stack_push(res, d);
+            NEXT;
+        }
+        CASE(OP_CLEAR) {
+            stack_clear(res);
+            NEXT;
+        }
+        CASE(OP_CBRT) {
+            int64_t a = stack_pop(res);
+            stack_push(res, icbrt(a));
+            NEXT;
+        }
+        CASE(OP_SQRT) {
+            int64_t a = stack_pop(res);
+            stack_push(res, isqrt(a));
+            NEXT;
+        }
+        CASE(OP_DISPLAY) {
+            OML_display(inst, *res);
+            NEXT;
+        }
+        CASE(OP_SET_IN_BASE) {
+            inst->input_base = stack_pop(res);
+            NEXT;
+        }
+        CASE(OP_SET_OUT_BASE) {
+            inst->output_base = stack_pop(res);
+            NEXT;
+        }
+        CASE(OP_REVERSE_N) {
+            stack_reverse_top(res, stack_pop(res));
+            NEXT;
+        }
+        // digit concatenation rom https://stackoverflow.com/a/12700533/4119004
+        CASE(OP_CONCAT) {
+            int64_t x, y, pow;
+            y = stack_pop(res);
+            x = stack_pop(res);
+            pow = 10;
+            while(y >= pow)
+                pow *= 10;
+            stack_push(res, x * pow + y);
+            NEXT;
+        }
+        CASE(OP_BITS) {
+            stack_push_digits(res, stack_pop(res), 2);
+            NEXT;
+        }
+        CASE(OP_DIGITS) {
+            stack_push_digits(res, stack_pop(res), inst->output_base);
+            NEXT;
+        }
+        CASE(OP_WRITE) {
+            int64_t stream, count;
+            stream = stack_pop(res);
+            count = stack_pop(res);
+            for(int64_t i = 0; i < count; i++) {
+                out_char(inst->out, stream, stack_pop(res));
+            }
+            NEXT;
+        }
+        CASE(OP_TRIPLICATE) {
+            int64_t x = stack_pop(res);
+            stack_push(res, x);
+            stack_push(res, x);
+            stack_push(res, x);
+            NEXT;
+        }
+        CASE(OP_RANGE) {
+            int64_t n = stack_pop(res);
+            for(int64_t i = 0; i < n; i++) {
+                stack_push(res, i);
+            }
+            NEXT;
+        }
+        CASE(OP_TOP_TO_BOTTOM) {
+            int64_t top = stack_pop(res);
+            stack_unshift(res, top);
+            NEXT;
+        }
+        CASE(OP_ENTER) {
+            int64_t count = stack_pop(res);
+            if(count < 0) {
+                count = 0;
+            }
+            if((size_t) count > res->size) {
+                count = res->size;
+            }
+            // the frame remembers how many members it hides
+            stack_push(&inst->stk_stk, res->size - count);
+            stack_enter(res, count);
+            inst->sub_stk_size++;
+            NEXT;
+        }
+        CASE(OP_REVERSE) {
+            stack_reverse(res);
+            NEXT;
+        }
+        CASE(OP_LEAVE) {
+            stack_leave(res, stack_pop(&inst->stk_stk));
+            inst->sub_stk_size--;
+            NEXT;
+        }
+        CASE(OP_XOR) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a ^ b);
+            NEXT;
+        }
+        CASE(OP_NEGATE) {
+            int64_t a = stack_pop(res);
+            stack_push(res, -a);
+            NEXT;
+        }
+        CASE(OP_POW) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, ipow(a, b));
+            NEXT;
+        }
+        CASE(OP_FLIP_BIT) {
+            int64_t k = stack_pop(res);
+            int64_t n = stack_pop(res);
+            stack_push(res, n ^ (1ull << k));
+            NEXT;
+        }
+        CASE(OP_COPY_NTH) {
+            int64_t index = stack_pop(res);
+            index = res->size - index - 1;
+            stack_push(res, STACK_AT(res, index));
+            NEXT;
+        }
+        CASE(OP_MOVE_NTH) {
+            int64_t index = stack_pop(res);
+            index = res->size - index - 1;
+            int64_t entry = stack_pop_from(res, index);
+            stack_push(res, entry);
+            NEXT;
+        }
+        CASE(OP_ISOLATE) {
+            int64_t top = stack_pop(res);
+            res->size = 0;
+            stack_push(res, top);
+            NEXT;
+        }
+        CASE(OP_STORE_VAR) {
+            inst->vars[instr->value] = stack_pop(res);
+            NEXT;
+        }
+        CASE(OP_LOAD_VAR) {
+            stack_push(res, inst->vars[instr->value]);
+            NEXT;
+        }
+        CASE(OP_INPUT_INT) {
+            stack_push(res, input_int(inst));
+            NEXT;
+        }
+        // read line
+        CASE(OP_INPUT_LINE) {
+            int c = 1;
+            size_t size = 0;
+            while((c = in_char(inst->in)) != 10 && c != EOF) {
+                stack_push(res, c);
+                size++;
+            }
+            if(c == 10) {
+                size++;
+                stack_push(res, c);
+            }
+            stack_reverse_top(res, size);
+            stack_push(res, size);
+            NEXT;
+        }
+        CASE(OP_INPUT_CHAR) {
+            stack_push(res, in_char(inst->in));
+            NEXT;
+        }
+
+        CASE(OP_LENGTH) {
+            stack_push(res, res->size);
+            NEXT;
+        }
+
+        CASE(OP_CUBE) {
+            int64_t n = stack_pop(res);
+            stack_push(res, n * n * n);
+            NEXT;
+        }
+
+        CASE(OP_SQUARE) {
+            int64_t n = stack_pop(res);
+            stack_push(res, n * n);
+            NEXT;
+        }
+
+        CASE(OP_PUT_CHAR) {
+            int64_t a = stack_pop(res);
+            out_char(inst->out, 1, (char) a);
+            NEXT;
+        }
+
+        CASE(OP_IN_BASE) {
+            stack_push(res, inst->input_base);
+            NEXT;
+        }
+
+        CASE(OP_OUT_BASE) {
+            stack_push(res, inst->output_base);
+            NEXT;
+        }
+
+        CASE(OP_DEPTH) {
+            stack_push(res, inst->sub_stk_size);
+            NEXT;
+        }
+        CASE(OP_STACK_STATS) {
+            STACK_STATS stats = res->stats;
+            stack_push(res, stats.resizes);
+            stack_push(res, stats.copied);
+            stack_push(res, stats.peak);
+            NEXT;
+        }
+
+        CASE(OP_PUT_STR) {
+            size_t size = stack_pop(res);
+            for(size_t i = 0; i < size; i++) {
+                out_char(inst->out, 1, (char) stack_pop(res));
+            }
+            NEXT;
+        }
+
+        CASE(OP_REG_PUSH) {
+            STACK* reg = &inst->reg_stk[instr->value];
+            // registers are allocated on first use; until then they are empty
+            if(reg->data == NULL) {
+                *reg = stack_init_in(inst->reg_arena);
+            }
+            stack_push(reg, stack_pop(res));
+            NEXT;
+        }
+
+        CASE(OP_FROM_BINARY) {
+            stack_push(res, stack_from_base(res, 2));
+            NEXT;
+        }
+        CASE(OP_FROM_BASE) {
+            stack_push(res, stack_from_base(res, inst->output_base));
+            NEXT;
+        }
+        CASE(OP_REG_POP) {
+            STACK* reg = &inst->reg_stk[instr->value];
+            stack_push(res, stack_pop(reg));
+            NEXT;
+        }
+        CASE(OP_REPEAT) {
+            int64_t repeater = stack_pop(res);
+            int64_t repetend = stack_pop(res);
+            while(repeater --> 0) {
+                stack_push(res, repetend);
+            }
+            NEXT;
+        }
+
+        CASE(OP_BOTTOM_TO_TOP) {
+            int64_t bot = stack_shift(res);
+            stack_push(res, bot);
+            NEXT;
+        }
+
+        CASE(OP_IF) {
+            if(!stack_pop(res)) {
+                JUMP(instr->target);
+            }
+            NEXT;
+        }
+        CASE(OP_OR) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a | b);
+            NEXT;
+        }
+
+        CASE(OP_COMPLEMENT) {
+            int64_t a = stack_pop(res);
+            stack_push(res, ~a);
+            NEXT;
+        }
+
+        // extended functions
+        CASE(OP_NOT) {
+            int64_t a = stack_pop(res);
+            stack_push(res, !a);
+            NEXT;
+        }
+        CASE(OP_PRINT_LN) {
+            int64_t a = stack_pop(res);
+            print_int(inst, a);
+            out_char(inst->out, 1, '\n');
+            NEXT;
+        }
+        // reduce (un-tested)
+        CASE(OP_REDUCE) {
+            inst->pc = pc;
+            if(!OML_body_kernel(inst, pc)) {
+                OML_reduce(inst, pc + 1, instr->target);
+            }
+            JUMP(instr->target);
+        }
+        CASE(OP_GE) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a >= b);
+            NEXT;
+        }
+        CASE(OP_NE) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a != b);
+            NEXT;
+        }
+        CASE(OP_LE) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, a <= b);
+            NEXT;
+        }
+        CASE(OP_IS_ALPHA) {
+            int64_t n = stack_pop(res);
+            stack_push(res, isalpha(n) != 0);
+            NEXT;
+        }
+        CASE(OP_TO_UPPER) {
+            int64_t n = stack_pop(res);
+            stack_push(res, toupper(n));
+            NEXT;
+        }
+        CASE(OP_PRINT_DECIMAL) {
+            int64_t n = stack_pop(res);
+            int64_t num = stack_pop(res);
+            double divisor = 1;
+            while(n --> 0) {
+                divisor *= 10;
+            }
+            out_printf(inst->out, 1, "%g", num / divisor);
+            NEXT;
+        }
+        CASE(OP_TO_LOWER) {
+            int64_t n = stack_pop(res);
+            stack_push(res, tolower(n));
+            NEXT;
+        }
+        CASE(OP_INPUT_DECIMAL) {
+            int64_t prec;
+            stack_push(res, input_decimal(inst, &prec));
             stack_push(res, prec);
-            
+            NEXT;
         }
-        else if(ident == 'e') {
+        CASE(OP_STDIN_REMAINING) {
             // set read flag as a test
-            stack_push(res, stdin_remaining());
+            stack_push(res, stdin_remaining(inst));
+            NEXT;
         }
-        else if(ident == 'i') {
-            while(stdin_remaining()) {
-                stack_push(res, input_int());
+        CASE(OP_INPUT_ALL) {
+            while(in_int_remaining(inst->in, inst->input_base)) {
+                stack_push(res, input_int(inst));
             }
-            OML_exec_cmd(inst, '\\');
+            stack_reverse(res);
+            NEXT;
         }
-        else if(ident == 'm') {
-            STACK* addr = malloc(sizeof(addr));
-            *addr = stack_init();
+        CASE(OP_NEW_STACK) {
+            STACK* addr = arena_alloc(inst->arena, sizeof(STACK));
+            *addr = stack_init_in(inst->arena);
+            stack_push(&inst->heaps, (intptr_t) addr);
+            inst->heap_count++;
             stack_push(res, (intptr_t) addr);
+            NEXT;
         }
-        else if(ident == 'n') {
+        CASE(OP_STACK_MOVE) {
             int64_t n = stack_pop(res);
             STACK* tmp = (STACK*)(intptr_t) stack_pop(res);
             for(int64_t c = n; c > 0; --c) {
-                stack_push(tmp, res->data[res->size - c]);
+                stack_push(tmp, STACK_AT(res, res->size - c));
             }
             for(int64_t c = n; c > 0; --c) {
                 stack_pop(res);
             }
             stack_push(res, (intptr_t) tmp);
+            NEXT;
         }
-        else if(ident == 'o') {
+        CASE(OP_STACK_DISPLAY) {
             STACK* tmp = (STACK*)(intptr_t) stack_peek(res);
-            stack_display(*tmp);
+            OML_display(inst, *tmp);
+            NEXT;
         }
-        else if(ident == 'p') {
+        CASE(OP_STACK_PUSH) {
             int64_t n = stack_pop(res);
             STACK* tmp = (STACK*)(intptr_t) stack_pop(res);
             stack_push(res, (intptr_t) tmp);
             stack_push(tmp, n);
+            NEXT;
         }
-        else if(ident == 'q') {
+        CASE(OP_STACK_POP) {
             STACK* tmp = (STACK*)(intptr_t) stack_pop(res);
             int64_t n = stack_pop(tmp);
             stack_push(res, n);
             stack_push(res, (intptr_t) tmp);
+            NEXT;
         }
         // map
-        else if(ident == '{') {
-            STACK temp = stack_from(*res);
-            size_t start = inst->i + 1, end = start;
-            // find end-point
-            int depth = 1;
-            while(depth && end < inst->size) {
-                if(inst->code[end] == '{')
-                    depth++;
-                else if(inst->code[end] == '}')
-                    depth--;
-                end++;
+        CASE(OP_MAP) {
+            inst->pc = pc;
+            if(OML_body_kernel(inst, pc)) {
+                // ran without the interpreter
             }
-            end--;
-            size_t res_size = end - start;
-            char* to_exec = malloc(res_size + 1);
-            to_exec[res_size] = '\0';
-            memcpy(to_exec, inst->code + start, res_size * sizeof(char));
-            
-            for(size_t i = 0; i < temp.size; i++) {
-                res->size = 0;
-                int64_t arg = temp.data[i];
-                OML_exec_str_args(inst, to_exec, 1, arg);
-                temp.data[i] = stack_pop(res);
+            else if(instr->value && inst->pool && res->size >= PARALLEL_MAP_MIN) {
+                OML_map_parallel(inst, pc + 1, instr->target, res);
             }
-            
-            inst->stk = stack_from(temp);
-            
-            inst->i = end;
+            else {
+                OML_map(inst, pc + 1, instr->target);
+            }
+            JUMP(instr->target);
+        }
+        CASE(OP_EXIT) {
+            // leaves the run, however deep in bodies, for OML_run to return
+            inst->exited = true;
+            inst->exit_code = stack_pop(res);
+            longjmp(*inst->exit_jump, 1);
+        }
+
+        // superinstructions
+        CASE(OP_ADD_IMM) {
+            int64_t a = stack_pop(res);
+            stack_push(res, a + instr->value);
+            NEXT;
+        }
+        CASE(OP_MUL_IMM) {
+            int64_t a = stack_pop(res);
+            stack_push(res, a * instr->value);
+            NEXT;
+        }
+        CASE(OP_MOD_IMM) {
+            int64_t a = stack_pop(res);
+            stack_push(res, a % instr->value);
+            NEXT;
         }
-        else if(ident == '~') {
-            exit(stack_pop(res));
+        CASE(OP_NIP) {
+            int64_t b = stack_pop(res);
+            stack_pop(res);
+            stack_push(res, b);
+            NEXT;
+        }
+
+        CASE(OP_BIG_ADD) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_add(inst, a, b));
+            NEXT;
+        }
+        CASE(OP_BIG_SUB) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_sub(inst, a, b));
+            NEXT;
+        }
+        CASE(OP_BIG_MUL) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_mul(inst, a, b));
+            NEXT;
+        }
+        CASE(OP_BIG_DIV) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            int64_t quot, rem;
+            big_divmod(inst, a, b, &quot, &rem);
+            stack_push(res, quot);
+            NEXT;
+        }
+        CASE(OP_BIG_MOD) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            int64_t quot, rem;
+            big_divmod(inst, a, b, &quot, &rem);
+            stack_push(res, rem);
+            NEXT;
+        }
+        CASE(OP_BIG_DIVMOD) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            int64_t quot, rem;
+            big_divmod(inst, a, b, &quot, &rem);
+            stack_push(res, quot);
+            stack_push(res, rem);
+            NEXT;
+        }
+        CASE(OP_BIG_NEGATE) {
+            int64_t a = stack_pop(res);
+            stack_push(res, big_negate(inst, a));
+            NEXT;
         }
+        CASE(OP_BIG_POW) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_pow(inst, a, b));
+            NEXT;
+        }
+        CASE(OP_BIG_FACTORIAL) {
+            int64_t a = stack_pop(res);
+            stack_push(res, big_factorial(inst, a));
+            NEXT;
+        }
+        CASE(OP_BIG_SQUARE) {
+            int64_t n = stack_pop(res);
+            stack_push(res, big_mul(inst, n, n));
+            NEXT;
+        }
+        CASE(OP_BIG_CUBE) {
+            int64_t n = stack_pop(res);
+            stack_push(res, big_mul(inst, big_mul(inst, n, n), n));
+            NEXT;
+        }
+        CASE(OP_BIG_CONCAT) {
+            int64_t y = stack_pop(res);
+            int64_t x = stack_pop(res);
+            stack_push(res, big_concat(inst, x, y));
+            NEXT;
+        }
+        CASE(OP_BIG_LT) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_compare(a, b) < 0);
+            NEXT;
+        }
+        CASE(OP_BIG_EQ) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_compare(a, b) == 0);
+            NEXT;
+        }
+        CASE(OP_BIG_GT) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_compare(a, b) > 0);
+            NEXT;
+        }
+        CASE(OP_BIG_GE) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_compare(a, b) >= 0);
+            NEXT;
+        }
+        CASE(OP_BIG_NE) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_compare(a, b) != 0);
+            NEXT;
+        }
+        CASE(OP_BIG_LE) {
+            int64_t b = stack_pop(res);
+            int64_t a = stack_pop(res);
+            stack_push(res, big_compare(a, b) <= 0);
+            NEXT;
+        }
+        CASE(OP_BIG_VECTOR) {
+            vec_big(inst, res, instr->value);
+            NEXT;
+        }
+        CASE(OP_BIG_WRAPPED) {
+            big_wrapped(inst, res, instr->value);
+            NEXT;
+        }
+#ifndef OML_THREADED_DISPATCH
+        default:
+            NEXT;
+#endif
+    }
+#ifdef OML_THREADED_DISPATCH
+done:
+#else
     }
+#endif
+    inst->pc = pc;
 }
 
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+
+// reports `reason' and leaves the run, as when memory runs out
+void OML_fail(OML* inst, const char* reason) {
+    out_printf(inst->out, 2, "Error: %s\n", reason);
+    inst->exited = true;
+    inst->exit_code = 1;
+    longjmp(*inst->exit_jump, 1);
+}
+
+// runs the whole program; if it ends with `e~', `exited' and `exit_code' say so
 void OML_run(OML* inst) {
-    while(inst->i < inst->size) {
-        char cur = inst->code[inst->i];
-        OML_exec_cmd(inst, cur);
-        inst->i++;
-    }
-    inst->i = 0;
+    jmp_buf exit;
+    jmp_buf* outer = inst->exit_jump;
+    inst->exited = false;
+    inst->exit_jump = &exit;
+    if(setjmp(exit) == 0) {
+        OML_run_range(inst, 0, inst->prog.size);
+    }
+    inst->exit_jump = outer;
+    if(inst->profile) {
+        OML_profile_stop(inst->profile);
+    }
+    inst->pc = 0;
 }
 
 void OML_diagnostic(OML* inst) {
-    printf(COLOR_HEADER("[START INSTANCE %p]") "\n", inst);
-    printf(COLOR_SUB_HEADER("(CODE)") "\n");
-    printf(COLOR_CODE("  %s") "\n  ", inst->code);
-    for(size_t i = 0; i < inst->i; i++) {
-        putchar('-');
+    // the source offset of the current instruction
+    size_t offset = inst->size;
+    if(inst->pc < inst->prog.size) {
+        offset = inst->prog.instrs[inst->pc].src;
+    }
+    out_printf(inst->out, 1, COLOR_HEADER("[START INSTANCE %p]") "\n", (void*) inst);
+    out_printf(inst->out, 1, COLOR_SUB_HEADER("(CODE)") "\n");
+    out_printf(inst->out, 1, COLOR_CODE("  %.*s") "\n  ", (int) inst->size, inst->code);
+    for(size_t i = 0; i < offset; i++) {
+        out_char(inst->out, 1, '-');
+    }
+    out_printf(inst->out, 1, "^ (%lu, instruction %lu)\n", (unsigned long) offset, (unsigned long) inst->pc);
+    out_printf(inst->out, 1, COLOR_SUB_HEADER("(STACK, size = %lu)") "\n", (unsigned long) inst->stk.size);
+    OML_display(inst, inst->stk);
+    out_printf(inst->out, 1, COLOR_HEADER("[END INSTANCE %p]") "\n", (void*) inst);
+}
+
+static void OML_stats_row(OML* inst, int fd, const char* name, STACK_STATS stats) {
+    out_printf(inst->out, fd, "  %-16s %10lu %16lu %12lu\n", name, (unsigned long) stats.resizes,
+        (unsigned long) stats.copied, (unsigned long) stats.peak);
+}
+
+/*
+ * Writes what the stacks of `inst' have cost to descriptor `fd': how often
+ * each was moved to a bigger buffer, the bytes those moves copied, and the
+ * most cells it held at once. The stacks that bodies ran on and those made
+ * by `em' are summed, keeping their largest peak. Stacks of the threads of
+ * -j are not counted.
+ */
+void OML_report_stats(OML* inst, int fd) {
+    STACK_STATS bodies = inst->body_stats, heaps = inst->heap_stats;
+    for(size_t i = 0; i < inst->spare_count; i++) {
+        stack_stats_add(&bodies, inst->spares[i].stats);
+    }
+    for(size_t i = 0; i < inst->heaps.size; i++) {
+        stack_stats_add(&heaps, ((STACK*)(intptr_t) STACK_AT(&inst->heaps, i))->stats);
+    }
+    char name[24];
+
+    out_printf(inst->out, fd, COLOR_HEADER("[STACK STATS]") "\n");
+    out_printf(inst->out, fd, "  %-16s %10s %16s %12s\n", "stack", "resizes", "bytes copied", "peak cells");
+    OML_stats_row(inst, fd, "main", inst->stk.stats);
+    OML_stats_row(inst, fd, "frames", inst->stk_stk.stats);
+    OML_stats_row(inst, fd, "bodies", bodies);
+    sprintf(name, "em (%lu made)", (unsigned long) inst->heap_count);
+    OML_stats_row(inst, fd, name, heaps);
+    // registers are listed once used
+    for(int reg = 0; reg < 256; reg++) {
+        if(inst->reg_stk[reg].data == NULL) {
+            continue;
+        }
+        if(isgraph(reg)) {
+            sprintf(name, "register %c", reg);
+        }
+        else {
+            sprintf(name, "register \\x%02x", reg);
+        }
+        OML_stats_row(inst, fd, name, inst->reg_stk[reg].stats);
     }
-    printf("^ (%lu)\n", (unsigned long) inst->i);
-    printf(COLOR_SUB_HEADER("(STACK, size = %lu)") "\n", (unsigned long) inst->stk.size);
-    stack_display(inst->stk);
-    printf(COLOR_HEADER("[END INSTANCE %p]") "\n", inst);
 }
 
-void OML_exec_str_stk(OML* inst, char* str, STACK stk) {
-    OML temp = *inst;
-    inst->stk = stack_init();
-    inst->stk_stk = stack_init();
-    inst->code = str;
-    inst->size = strlen(str);
+/*
+ * Bodies run on stacks of their own, taken from a handful of spares kept by
+ * the instance, so that running one allocates nothing once the spares have
+ * grown. Only the stacks, frame depth and position of the caller are set
+ * aside while a body runs; variables and registers are shared with it.
+ *
+ * A body can end the run with `e~' however deep it is, so each one that
+ * sets state aside is where `e~' leaves to while it runs: it puts the state
+ * back, then passes the exit on to the one running it, and so out to
+ * OML_run.
+ */
+typedef struct OML_CALL {
+    STACK stk, stk_stk;
+    size_t pc, sub_stk_size;
+    jmp_buf exit;
+    jmp_buf* outer;     /* where `e~' left to before */
+} OML_CALL;
+
+// passes an exit on to the body or run enclosing the one that has just put
+// its state back; without one, as for OML_exec_str outside a run, returns
+static void OML_exit_outward(OML* inst) {
+    if(inst->exit_jump) {
+        longjmp(*inst->exit_jump, 1);
+    }
+}
+
+// an empty stack from the spares of `inst', or a new one
+static STACK OML_spare_take(OML* inst) {
+    if(inst->spare_count == 0) {
+        return stack_init_in(inst->arena);
+    }
+    STACK stk = inst->spares[--inst->spare_count];
+    stk.size = stk.base = 0;
+    return stk;
+}
+
+static void OML_spare_give(OML* inst, STACK stk) {
+    if(inst->spare_count < OML_MAX_SPARES) {
+        inst->spares[inst->spare_count++] = stk;
+    }
+    else {
+        stack_stats_add(&inst->body_stats, stk.stats);
+        stack_destroy(&stk);
+    }
+}
+
+// sets aside the stacks of the caller, and gives `inst' empty ones
+static void OML_call_enter(OML* inst, OML_CALL* call) {
+    call->stk = inst->stk;
+    call->stk_stk = inst->stk_stk;
+    call->pc = inst->pc;
+    call->sub_stk_size = inst->sub_stk_size;
+    inst->stk = OML_spare_take(inst);
+    inst->stk_stk = OML_spare_take(inst);
     inst->sub_stk_size = 0;
-    inst->i = 0;
-    for(size_t i = 0; i < stk.size; i++) {
-        stack_push(&inst->stk, stk.data[i]);
+    call->outer = inst->exit_jump;
+    inst->exit_jump = &call->exit;
+}
+
+static void OML_call_leave(OML* inst, OML_CALL* call) {
+    OML_spare_give(inst, inst->stk_stk);
+    OML_spare_give(inst, inst->stk);
+    inst->stk = call->stk;
+    inst->stk_stk = call->stk_stk;
+    inst->pc = call->pc;
+    inst->sub_stk_size = call->sub_stk_size;
+    inst->exit_jump = call->outer;
+}
+
+// runs the body [start, end) on a stack holding only `n', giving its top
+static int64_t OML_apply(OML* inst, size_t start, size_t end, int64_t n) {
+    inst->stk.size = inst->stk.base = 0;
+    inst->stk_stk.size = 0;
+    inst->sub_stk_size = 0;
+    stack_push(&inst->stk, n);
+    OML_run_range(inst, start, end);
+    return stack_pop(&inst->stk);
+}
+
+// runs the instructions in [start, end) over a fresh stack holding `stk'
+void OML_exec_body(OML* inst, size_t start, size_t end, STACK stk) {
+    OML_CALL call;
+    bool exiting = false;
+    OML_call_enter(inst, &call);
+    if(setjmp(call.exit) == 0) {
+        for(size_t i = 0; i < stk.size; i++) {
+            stack_push(&inst->stk, STACK_AT(&stk, i));
+        }
+        OML_run_range(inst, start, end);
+        for(size_t i = 0; i < inst->stk.size; i++) {
+            stack_push(&call.stk, STACK_AT(&inst->stk, i));
+        }
+    }
+    else {
+        exiting = true;
+    }
+    OML_call_leave(inst, &call);
+    if(exiting) {
+        OML_exit_outward(inst);
+    }
+}
+
+// replaces each member of the stack with the top left by the body
+// [start, end) run on it alone
+void OML_map(OML* inst, size_t start, size_t end) {
+    OML_CALL call;
+    bool exiting = false;
+    OML_call_enter(inst, &call);
+    if(setjmp(call.exit) == 0) {
+        for(size_t i = 0; i < call.stk.size; i++) {
+            STACK_AT(&call.stk, i) = OML_apply(inst, start, end, STACK_AT(&call.stk, i));
+        }
+    }
+    else {
+        exiting = true;
     }
-    // OML_diagnostic(inst);
-    // stk.size = 0;
-    // registers can stay
+    OML_call_leave(inst, &call);
+    if(exiting) {
+        OML_exit_outward(inst);
+    }
+}
+
+// runs the body [start, end) over the stack in place until one member is left
+void OML_reduce(OML* inst, size_t start, size_t end) {
+    STACK frames = inst->stk_stk;
+    size_t depth = inst->sub_stk_size;
+    size_t base = inst->stk.base;
+    jmp_buf exit;
+    jmp_buf* outer = inst->exit_jump;
+    bool exiting = false;
+    inst->stk_stk = OML_spare_take(inst);
+    inst->exit_jump = &exit;
+    if(setjmp(exit) == 0) {
+        while(inst->stk.size != 1) {
+            inst->stk_stk.size = 0;
+            inst->sub_stk_size = 0;
+            OML_run_range(inst, start, end);
+            // members hidden by frames the body left open are dropped with them
+            if(inst->stk.base > base) {
+                size_t hidden = inst->stk.base - base;
+                stack_leave(&inst->stk, hidden);
+                while(hidden --> 0) {
+                    stack_shift(&inst->stk);
+                }
+            }
+        }
+    }
+    else {
+        // an exit keeps the members, but not the frames the body opened
+        exiting = true;
+        stack_leave(&inst->stk, inst->stk.base - base);
+    }
+    OML_spare_give(inst, inst->stk_stk);
+    inst->stk_stk = frames;
+    inst->sub_stk_size = depth;
+    inst->exit_jump = outer;
+    if(exiting) {
+        OML_exit_outward(inst);
+    }
+}
+
+typedef struct OML_MAP_JOB {
+    OML* workers;
+    size_t start, end;
+    STACK* items;
+} OML_MAP_JOB;
+
+static void OML_map_chunk(void* arg, size_t worker, size_t lo, size_t hi) {
+    OML_MAP_JOB* job = arg;
+    OML* inst = &job->workers[worker];
+    for(size_t i = lo; i < hi; i++) {
+        STACK_AT(job->items, i) = OML_apply(inst, job->start, job->end, STACK_AT(job->items, i));
+    }
+}
+
+// copies of `inst' for each thread of its pool, each with its own stacks
+static OML* OML_workers_init(OML* inst) {
+    size_t count = OML_pool_workers(inst->pool);
+    OML* workers = malloc(count * sizeof(OML));
+    for(size_t i = 0; i < count; i++) {
+        workers[i] = *inst;
+        // arenas are not shared between threads
+        workers[i].arena = arena_init();
+        workers[i].stk = stack_init_in(workers[i].arena);
+        workers[i].stk_stk = stack_init_in(workers[i].arena);
+        workers[i].heaps = stack_init_in(workers[i].arena);
+        workers[i].spare_count = 0;
+        // loop counters are not shared, and nested maps stay on their thread
+        workers[i].jit = NULL;
+        workers[i].pool = NULL;
+        // nor is the profile; their time is charged to the map
+        workers[i].profile = NULL;
+        // an exit is the business of the thread it happens on
+        workers[i].exit_jump = NULL;
+        // each draws from its own stream, 2^64 numbers past the last one's
+        jump(inst->rng);
+    }
+    return workers;
+}
+
+static void OML_workers_destroy(OML* inst, OML* workers) {
+    for(size_t i = 0; i < OML_pool_workers(inst->pool); i++) {
+        arena_destroy(workers[i].arena);
+    }
+    free(workers);
+}
+
+// maps the pure body [start, end) over `items' in place, on every thread of
+// the pool; each thread runs on its own copy of the interpreter state
+void OML_map_parallel(OML* inst, size_t start, size_t end, STACK* items) {
+    OML_MAP_JOB job = { OML_workers_init(inst), start, end, items };
+    OML_pool_run(inst->pool, OML_map_chunk, &job, items->size);
+    OML_workers_destroy(inst, job.workers);
+}
+
+// runs the program over one number of -n, as a fresh stack
+static int64_t OML_run_number(OML* inst, int64_t n) {
+    stack_push(&inst->stk, n);
     OML_run(inst);
-    // OML_diagnostic(inst);
-    for(size_t i = 0; i < inst->stk.size; i++) {
-        stack_push(&temp.stk, inst->stk.data[i]);
+    int64_t res = stack_pop(&inst->stk);
+    OML_reset(inst);
+    return res;
+}
+
+typedef struct OML_NUMBERS_PIECE {
+    const char *start, *end;
+    char* out;
+    size_t out_size, out_capacity;
+    bool stopped;       /* whether text that is not a number ended it */
+} OML_NUMBERS_PIECE;
+
+typedef struct OML_NUMBERS_JOB {
+    OML* workers;
+    OML_NUMBERS_PIECE* pieces;
+} OML_NUMBERS_JOB;
+
+static void OML_numbers_chunk(void* arg, size_t worker, size_t lo, size_t hi) {
+    OML_NUMBERS_JOB* job = arg;
+    OML* inst = &job->workers[worker];
+    for(size_t i = lo; i < hi; i++) {
+        OML_NUMBERS_PIECE* piece = &job->pieces[i];
+        const char* pos = piece->start;
+        int64_t n;
+        piece->out_size = 0;
+        while(parse_int(&pos, piece->end, inst->input_base, &n)) {
+            if(piece->out_capacity - piece->out_size < FORMAT_INT_SIZE + 1) {
+                piece->out_capacity = 2 * piece->out_capacity + FORMAT_INT_SIZE + 1;
+                piece->out = realloc(piece->out, piece->out_capacity);
+            }
+            char* out = piece->out + piece->out_size;
+            size_t size = format_int(out, OML_run_number(inst, n), inst->output_base);
+            out[size] = '\n';
+            piece->out_size += size + 1;
+        }
+        piece->stopped = pos != piece->end;
+    }
+}
+
+/*
+ * Runs the program over the numbers of stdin in parallel, for -n with -j.
+ * Blocks of input are cut into pieces at whitespace; each thread parses its
+ * pieces, runs its own copy of the interpreter over their numbers and
+ * formats the results into the piece's buffer. The buffers are then written
+ * out in input order, so the output is that of running serially.
+ */
+static void OML_run_numbers_parallel(OML* inst) {
+    size_t count = OML_pool_workers(inst->pool) * POOL_CHUNKS_PER_WORKER;
+    OML_NUMBERS_JOB job = { OML_workers_init(inst), calloc(count, sizeof(OML_NUMBERS_PIECE)) };
+    const char* text;
+    size_t size;
+    bool stopped = false;
+    while(!stopped && (size = in_take_block(inst->in, &text)) > 0) {
+        const char* end = text + size;
+        const char* cut = text;
+        for(size_t i = 0; i < count; i++) {
+            job.pieces[i].start = cut;
+            cut = i + 1 == count ? end : text + size * (i + 1) / count;
+            if(cut < job.pieces[i].start) {
+                cut = job.pieces[i].start;
+            }
+            // never split a number
+            while(cut < end && !in_is_space(*cut)) {
+                cut++;
+            }
+            job.pieces[i].end = cut;
+        }
+        OML_pool_run(inst->pool, OML_numbers_chunk, &job, count);
+        for(size_t i = 0; i < count && !stopped; i++) {
+            out_write(inst->out, 1, job.pieces[i].out, job.pieces[i].out_size);
+            stopped = job.pieces[i].stopped;
+        }
+    }
+    for(size_t i = 0; i < count; i++) {
+        free(job.pieces[i].out);
+    }
+    free(job.pieces);
+    OML_workers_destroy(inst, job.workers);
+}
+
+/*
+ * Runs the program over each number of stdin, printing what it leaves on
+ * top. Records are independent unless the program keeps state between them
+ * (variables, registers, I/O, the bases or the random stream), so with a
+ * pool and a program that does not, they run in parallel. A program drawing
+ * random numbers runs serially, so that a seed gives the same output
+ * however many threads there are.
+ */
+void OML_run_numbers(OML* inst) {
+    if(inst->pool && OML_body_pure(&inst->prog, 0, inst->prog.size)
+            && !OML_body_random(&inst->prog, 0, inst->prog.size)
+            && 2 <= inst->output_base && inst->output_base <= 36) {
+        OML_run_numbers_parallel(inst);
+        return;
+    }
+    while(in_int_remaining(inst->in, inst->input_base)) {
+        int64_t res = OML_run_number(inst, input_int(inst));
+        if(inst->exited) {
+            return;
+        }
+        print_int(inst, res);
+        out_char(inst->out, 1, '\n');
+    }
+}
+
+void OML_exec_str_stk(OML* inst, char* str, STACK stk) {
+    OML_PROGRAM prog = inst->prog;
+    // compiled loops and the profile belong to the outer program
+    struct OML_JIT* jit = inst->jit;
+    struct OML_PROFILE* profile = inst->profile;
+    jmp_buf exit;
+    jmp_buf* outer = inst->exit_jump;
+    bool exiting = false;
+    inst->prog = OML_compile(str, strlen(str));
+    inst->jit = NULL;
+    inst->profile = NULL;
+    inst->exit_jump = &exit;
+    if(setjmp(exit) == 0) {
+        OML_exec_body(inst, 0, inst->prog.size, stk);
+    }
+    else {
+        exiting = true;
+    }
+    free(inst->prog.instrs);
+    inst->prog = prog;
+    inst->jit = jit;
+    inst->profile = profile;
+    inst->exit_jump = outer;
+    if(exiting) {
+        OML_exit_outward(inst);
     }
-    *inst = temp;
 }
 
 void OML_exec_str_args(OML* inst, char* str, size_t argc, ...) {
     va_list args;
     va_start(args, argc);
-    STACK arg_stk = stack_init();
+    STACK arg_stk = stack_init_in(inst->arena);
     for(size_t i = 0; i < argc; i++) {
         int64_t n = va_arg(args, int64_t);
         stack_push(&arg_stk, n);
     }
+    va_end(args);
     OML_exec_str_stk(inst, str, arg_stk);
+    stack_destroy(&arg_stk);
 }
 
 void OML_exec_str(OML* inst, char* str) {
     OML_exec_str_args(inst, str, 0);
 }
 
-OML OML_init(char* str, size_t size) {
+static OML OML_init(char* str, size_t size) {
     OML inst;
-    inst.stk = stack_init();
-    inst.stk_stk = stack_init();
+    inst.arena = arena_init();
+    inst.reg_arena = arena_init();
+    inst.stk = stack_init_in(inst.arena);
+    inst.stk_stk = stack_init_in(inst.arena);
     inst.code = str;
-    inst.i = 0;
     inst.size = size;
+    inst.prog = OML_compile(str, size);
+    inst.jit = NULL;
+    inst.pool = NULL;
+    inst.profile = NULL;
+    inst.spare_count = 0;
+    inst.pc = 0;
     inst.sub_stk_size = 0;
-    for(int i = 0; i < 256; i++) {
-        inst.reg_stk[i] = stack_init();
-    }
+    inst.out = out_init();
+    inst.in = in_init(inst.out);
+    inst.input_base = inst.output_base = 10;
+    inst.bigint = false;
+    inst.big_arena = NULL;
+    inst.exited = false;
+    inst.exit_code = 0;
+    inst.exit_jump = NULL;
+    memset(inst.vars, 0, sizeof(inst.vars));
+    memset(inst.reg_stk, 0, sizeof(inst.reg_stk));
+    inst.heaps = stack_init_in(inst.arena);
+    inst.heap_stats = inst.body_stats = (STACK_STATS) { 0, 0, 0 };
+    inst.heap_count = 0;
     return inst;
 }
 
-OML OML_exec(char* str, size_t size) {
-    OML inst = OML_init(str, size);
-    OML_run(&inst);
+// a new instance with its own copy of `code', writing to stdout and stderr
+// and reading stdin until told otherwise
+OML* OML_create(const char* code, size_t size) {
+    // the code is kept right after the instance
+    OML* inst = malloc(sizeof(OML) + size + 1);
+    char* copy = (char*) (inst + 1);
+    memcpy(copy, code, size);
+    copy[size] = '\0';
+    *inst = OML_init(copy, size);
+    seed(inst->rng, ms_delay(), (uintptr_t) inst);
     return inst;
 }
 
-void show_help(char* file_name) {
-    eprintf("[[ OML - Ordinal Manipulation Language ]]\n");
-    eprintf(COLOR_HEADER("== Usage ==\n"));
-    eprintf(COLOR_CODE("%s [args] <code>\n"), file_name);
-    eprintf(COLOR_HEADER("== Arguments ==\n"));
-    eprintf("  -?   show this help page\n");
-    eprintf("  -b   treat the input base as binary initially\n");
-    eprintf("  -f   read program from file `<code>' instead\n");
-    eprintf("  -h   treat the input base as hexadecimal initially\n");
-    eprintf("  -n   execute the program over the numbers of stdin\n");
-    eprintf(COLOR_HEADER("== About ==\n"));
-    eprintf("OML is a language similar to dc with its primary data type being the integer.\n");
-    eprintf("Like in dc, all numbers are stored on the `stack', to which integers are added\n");
-    eprintf("or removed. OML is a tool that can perform arithmetic calculations and generic\n");
-    eprintf("algorithms, with some effort. While esoteric in nature, it still can provide\n");
-    eprintf("succinct utilities.\n");
-    eprintf(COLOR_HEADER("== Examples ==\n"));
-    eprintf("Convert hexadecimal to decimal: "COLOR_CODE("%s -hn")"\n", file_name);
-    eprintf("Convert hexadecimal to binary: "COLOR_CODE("%s -hn 2Q")"\n", file_name);
-    eprintf("N-th fibonacci: "COLOR_CODE("%s '01h(Z:@+z1-)\\d'")"\n", file_name);
-}
-
-int main(int argc, char** argv) {
-    if(argc < 2) {
-        eprintf("Error: insufficient arguments passed to %s.", argv[0]);
-        return 1;
-    }
-    char* prog = "";
-    size_t prog_len;
-    bool from_file = false, over_numbers = false;
-    for(int i = 1; i < argc; i++) {
-        char* arg = argv[i];
-        if(arg[0] == '-') {
-            arg++;
-            while(*arg) {
-                if(*arg == 'f')
-                    from_file = true;
-                else if(*arg == 'n')
-                    over_numbers = true;
-                else if(*arg == 'o')
-                    INPUT_BASE = 8;
-                else if(*arg == 'h')
-                    INPUT_BASE = 16;
-                else if(*arg == 'b')
-                    INPUT_BASE = 2;
-                else if(*arg == 'O')
-                    OUTPUT_BASE = 8;
-                else if(*arg == 'H')
-                    OUTPUT_BASE = 16;
-                else if(*arg == 'B')
-                    OUTPUT_BASE = 2;
-                else if(*arg == '?') {
-                    show_help(argv[0]);
-                    return -1;
-                }
-                arg++;
-            }
+// hands the output of `inst' to `sink' rather than writing it to stdout and
+// stderr; `sink' gets the descriptor each piece of output was meant for
+void OML_set_output(OML* inst, OML_SINK sink, void* data) {
+    out_set_sink(inst->out, sink, data);
+}
+
+// has `inst' read its input from `source' rather than stdin
+void OML_set_input(OML* inst, OML_SOURCE source, void* data) {
+    in_set_source(inst->in, source, data);
+}
+
+// restarts the random numbers of `inst' from `value', so that runs repeat
+void OML_seed(OML* inst, uint64_t value) {
+    seed_from(inst->rng, value);
+}
+
+/*
+ * Has the arithmetic of `inst' check for overflow, promoting results that
+ * do not fit in 63 bits to big numbers rather than wrapping; printing and
+ * display then show them in full. Only the arithmetic and comparisons know
+ * big numbers: other commands take them for some very negative number. A
+ * value that wraps or is read as input where big numbers are kept is made
+ * a big number too, so no cell is taken for one it is not. Call before
+ * OML_optimize, whose superinstructions do not check.
+ */
+void OML_set_bigint(OML* inst) {
+    static const unsigned char BIG_OPCODES[OP_COUNT] = {
+        [OP_ADD] = OP_BIG_ADD,      [OP_SUB] = OP_BIG_SUB,      [OP_MUL] = OP_BIG_MUL,
+        [OP_DIV] = OP_BIG_DIV,      [OP_MOD] = OP_BIG_MOD,      [OP_DIVMOD] = OP_BIG_DIVMOD,
+        [OP_NEGATE] = OP_BIG_NEGATE,[OP_POW] = OP_BIG_POW,      [OP_FACTORIAL] = OP_BIG_FACTORIAL,
+        [OP_SQUARE] = OP_BIG_SQUARE,[OP_CUBE] = OP_BIG_CUBE,    [OP_CONCAT] = OP_BIG_CONCAT,
+        [OP_LT] = OP_BIG_LT,        [OP_EQ] = OP_BIG_EQ,        [OP_GT] = OP_BIG_GT,
+        [OP_GE] = OP_BIG_GE,        [OP_NE] = OP_BIG_NE,        [OP_LE] = OP_BIG_LE,
+    };
+    static const bool WRAPPED[OP_COUNT] = {
+        [OP_COMPLEMENT] = true,     [OP_AND] = true,            [OP_OR] = true,
+        [OP_XOR] = true,            [OP_FLIP_BIT] = true,       [OP_FROM_BINARY] = true,
+        [OP_FROM_BASE] = true,      [OP_RANDOM] = true,         [OP_RANDOM_FILL] = true,
+        [OP_INPUT_DECIMAL] = true,
+    };
+    OML_PROGRAM* prog = &inst->prog;
+    inst->bigint = true;
+    for(size_t i = 0; i < prog->size; i++) {
+        int op = prog->instrs[i].op;
+        if(BIG_OPCODES[op]) {
+            prog->instrs[i].op = BIG_OPCODES[op];
         }
-        else {
-            prog = arg;
+        // the whole-stack commands share one, told apart by its value
+        else if(op >= OP_ADD_ALL && op <= OP_DIFFERENCES) {
+            prog->instrs[i].op = OP_BIG_VECTOR;
+            prog->instrs[i].value = op;
         }
-    }
-    if(from_file) {
-        prog = read_file(prog, &prog_len);
-    }
-    else {
-        prog_len = strlen(prog);
-    }
-    srand(ms_delay());
-    seed(rand(), rand());
-    OML res;
-    if(over_numbers) {
-        res = OML_init(prog, prog_len);
-        while(!feof(stdin)) {
-            int64_t n = input_int();
-            stack_push(&res.stk, n);
-            OML_run(&res);
-            print_int(stack_pop(&res.stk));
-            putchar('\n');
-            stack_clear(&res.stk);
+        // so do the commands whose results wrap
+        else if(WRAPPED[op]) {
+            prog->instrs[i].op = OP_BIG_WRAPPED;
+            prog->instrs[i].value = op;
         }
     }
-    else {
-        res = OML_exec(prog, prog_len);
-        stack_display(res.stk);
+    // maps that now make big numbers must stay on this thread
+    for(size_t i = 0; i < prog->size; i++) {
+        if(prog->instrs[i].op == OP_MAP) {
+            prog->instrs[i].value = OML_body_pure(prog, i + 1, prog->instrs[i].target);
+        }
     }
 }
+
+// writes out everything `inst' has buffered
+void OML_flush(OML* inst) {
+    out_flush_all(inst->out);
+}
+
+// empties the stacks for a new run, releasing the arena in bulk. variables
+// and registers carry over; heap stacks made by `em' do not. the stats of
+// the stacks are kept, for --stats to cover every run
+void OML_reset(OML* inst) {
+    STACK_STATS stk = inst->stk.stats, stk_stk = inst->stk_stk.stats;
+    for(size_t i = 0; i < inst->heaps.size; i++) {
+        stack_stats_add(&inst->heap_stats, ((STACK*)(intptr_t) STACK_AT(&inst->heaps, i))->stats);
+    }
+    for(size_t i = 0; i < inst->spare_count; i++) {
+        stack_stats_add(&inst->body_stats, inst->spares[i].stats);
+    }
+    arena_reset(inst->arena);
+    inst->stk = stack_init_in(inst->arena);
+    inst->stk.stats = stk;
+    inst->stk_stk = stack_init_in(inst->arena);
+    inst->stk_stk.stats = stk_stk;
+    inst->heaps = stack_init_in(inst->arena);
+    inst->sub_stk_size = 0;
+    inst->spare_count = 0;
+}
+
+// flushes the output of an instance from OML_create, and frees it
+void OML_destroy(OML* inst) {
+    OML_jit_destroy(inst->jit);
+    OML_pool_destroy(inst->pool);
+    OML_profile_destroy(inst->profile);
+    arena_destroy(inst->arena);
+    arena_destroy(inst->reg_arena);
+    arena_destroy(inst->big_arena);
+    in_destroy(inst->in);
+    out_destroy(inst->out);
+    free(inst->prog.instrs);
+    free(inst);
+}
@@ -1,7 +1,9 @@
 #ifndef OML_INCL
 #define OML_INCL
 #include <inttypes.h>   /* for int64_t */
+#include <setjmp.h>     /* for jmp_buf */
 #include <stdbool.h>    /* for true, false, bool */
+#include <stddef.h>     /* for size_t */
 
 /* colors */
 #define COLOR_RESET     "\x1b[0m"
@@ -9,67 +11,271 @@
 #define COLOR_SUB_HEADER(x) "\x1b[35m" x COLOR_RESET
 #define COLOR_CODE(x)   "\x1b[1;34m" x COLOR_RESET
 
+/* what a stack has cost over its life, for `eT' and --stats */
+typedef struct STACK_STATS {
+    size_t resizes;     /* fresh buffers the cells were moved to */
+    size_t copied;      /* bytes moved into them */
+    size_t peak;        /* most cells held at once, frames included */
+} STACK_STATS;
+
+/* a deque over a ring buffer; capacity is always a power of two. the `base'
+   cells below head belong to the frames opened by `[' */
 typedef struct STACK {
-    size_t capacity, size;
+    size_t capacity, size, head, base;
     int64_t* data;
+    struct OML_ARENA* arena;    /* owner of data, or NULL if malloc'd */
+    STACK_STATS stats;
+    size_t limit;       /* cells past which a push takes its slow path: the
+                           capacity, or one past the peak if less */
 } STACK;
 
+/* the `i'th member from the bottom */
+#define STACK_AT(stk, i) ((stk)->data[((stk)->head + (i)) & ((stk)->capacity - 1)])
+
+/* counts the cells `stk' holds now towards its peak */
+#define STACK_NOTE_PEAK(stk) \
+    ((stk)->stats.peak = (stk)->base + (stk)->size > (stk)->stats.peak \
+        ? (stk)->base + (stk)->size : (stk)->stats.peak)
+
+/* opcodes of compiled instructions; see commands.txt for their commands */
+enum OML_OPCODE {
+    OP_NOP,
+    /* operands */
+    OP_PUSH, OP_STRING, OP_STORE_VAR, OP_LOAD_VAR, OP_REG_PUSH, OP_REG_POP,
+    /* control flow */
+    OP_WHILE, OP_END_WHILE, OP_IF, OP_REDUCE, OP_MAP, OP_EXIT,
+    /* arithmetic */
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_DIVMOD, OP_NEGATE, OP_POW,
+    OP_FACTORIAL, OP_SQUARE, OP_CUBE, OP_SQRT, OP_CBRT, OP_CONCAT, OP_RANDOM,
+    OP_RANDOM_FILL, OP_IS_PRIME,
+    /* bitwise and logic */
+    OP_AND, OP_OR, OP_XOR, OP_COMPLEMENT, OP_FLIP_BIT, OP_NOT,
+    OP_LT, OP_EQ, OP_GT, OP_GE, OP_NE, OP_LE,
+    /* stack manipulation */
+    OP_DROP, OP_DUP, OP_SWAP, OP_OVER, OP_ROT, OP_TRIPLICATE, OP_DUP_N,
+    OP_CLEAR, OP_REVERSE, OP_REVERSE_N, OP_RANGE, OP_REPEAT, OP_ISOLATE,
+    OP_COPY_NTH, OP_MOVE_NTH, OP_TOP_TO_BOTTOM, OP_BOTTOM_TO_TOP, OP_LENGTH,
+    OP_BITS, OP_DIGITS, OP_FROM_BINARY, OP_FROM_BASE, OP_ENTER, OP_LEAVE,
+    OP_DEPTH, OP_STACK_STATS,
+    /* input and output */
+    OP_PRINT, OP_PRINT_LN, OP_PRINT_DECIMAL, OP_DISPLAY, OP_PUT_CHAR,
+    OP_PUT_STR, OP_WRITE, OP_INPUT_INT, OP_INPUT_LINE, OP_INPUT_CHAR,
+    OP_INPUT_DECIMAL, OP_INPUT_ALL, OP_STDIN_REMAINING, OP_SET_IN_BASE,
+    OP_SET_OUT_BASE, OP_IN_BASE, OP_OUT_BASE,
+    /* characters */
+    OP_IS_ALPHA, OP_TO_UPPER, OP_TO_LOWER,
+    /* heap stacks */
+    OP_NEW_STACK, OP_STACK_MOVE, OP_STACK_DISPLAY, OP_STACK_PUSH,
+    OP_STACK_POP,
+    /* whole-stack arithmetic */
+    OP_ADD_ALL, OP_MUL_ALL, OP_MOD_ALL, OP_SUM, OP_PRODUCT, OP_MINIMUM,
+    OP_MAXIMUM, OP_SCAN, OP_DIFFERENCES,
+    /* superinstructions produced by OML_optimize */
+    OP_ADD_IMM, OP_MUL_IMM, OP_MOD_IMM, OP_NIP,
+    /* overflow-checked arithmetic substituted by OML_set_bigint */
+    OP_BIG_ADD, OP_BIG_SUB, OP_BIG_MUL, OP_BIG_DIV, OP_BIG_MOD, OP_BIG_DIVMOD,
+    OP_BIG_NEGATE, OP_BIG_POW, OP_BIG_FACTORIAL, OP_BIG_SQUARE, OP_BIG_CUBE,
+    OP_BIG_CONCAT, OP_BIG_LT, OP_BIG_EQ, OP_BIG_GT, OP_BIG_GE, OP_BIG_NE,
+    OP_BIG_LE, OP_BIG_VECTOR, OP_BIG_WRAPPED,
+    OP_COUNT
+};
+
+typedef struct OML_INSTR {
+    int op;
+    size_t src;         /* offset of the command in the source */
+    size_t target;      /* instruction to continue at, or end of a body */
+    int64_t value;      /* literal, variable, register or string length;
+                           for `e{', whether its body is pure; for
+                           OP_BIG_VECTOR and OP_BIG_WRAPPED, the opcode it
+                           stands in for */
+    char* str;          /* characters of a string literal */
+} OML_INSTR;
+
+typedef struct OML_PROGRAM {
+    OML_INSTR* instrs;
+    size_t size;
+} OML_PROGRAM;
+
+/* stacks an instance keeps around for bodies once they have run */
+#define OML_MAX_SPARES  (16)
+
+/* receives output an instance flushes for descriptor `fd' */
+typedef void (*OML_SINK)(void* data, int fd, const char* buf, size_t size);
+/* fills up to `size' bytes of `buf' with input, giving how many; 0 at the end */
+typedef size_t (*OML_SOURCE)(void* data, char* buf, size_t size);
+
+/* outcomes of entering a compiled loop */
+enum { JIT_INTERPRET, JIT_LOOP_DONE };
+
+/* the fields read on every instruction come first, to share a cache line */
 typedef struct OML {
     STACK stk;
+    OML_PROGRAM prog;
+    struct OML_JIT* jit;        /* compiled loops, or NULL to interpret */
+    struct OML_POOL* pool;      /* threads for pure maps, or NULL to map serially */
+    struct OML_PROFILE* profile;    /* time spent by instruction, or NULL not to profile */
+    size_t pc, sub_stk_size;
     STACK stk_stk;
-    STACK reg_stk[256];
     int64_t vars[256];
     char* code;
-    size_t i, size, sub_stk_size;
+    size_t size;
+    STACK spares[OML_MAX_SPARES];   /* emptied stacks kept for running bodies on */
+    size_t spare_count;
+    struct OML_ARENA* arena;    /* memory of the stacks of a run */
+    struct OML_ARENA* reg_arena;    /* memory of the registers, kept across runs */
+    struct OML_OUTPUT* out;
+    struct OML_INPUT* in;
+    int input_base, output_base;
+    uint64_t rng[2];            /* xoroshiro128+ state */
+    bool bigint;                /* whether arithmetic promotes to big numbers */
+    struct OML_ARENA* big_arena;    /* memory of the big numbers, kept across runs */
+    bool exited;                /* whether the last run ended with `e~' */
+    int exit_code;
+    jmp_buf* exit_jump;         /* where `e~' leaves to: the innermost body
+                                   running, else the run, else NULL */
+    STACK reg_stk[256];         /* allocated on first push */
+    STACK heaps;                /* addresses of the stacks made by `em' */
+    STACK_STATS heap_stats;     /* of those let go of by OML_reset */
+    STACK_STATS body_stats;     /* of the stacks bodies ran on, let go of */
+    size_t heap_count;          /* stacks made by `em' since OML_create */
 } OML;
 
-int     OUTPUT_BASE = 10;
-int     INPUT_BASE  = 10;
-char    ALPHABET[]  = "0123456789abcdefghijklmnopqrstuvwxyz";
-
 /* stack methods */
 STACK   stack_init              (void);
+STACK   stack_init_in           (struct OML_ARENA*);
 STACK   stack_from              (STACK);
 int     stack_push              (STACK*, int64_t);
 int     stack_resize            (STACK*);
+int     stack_reserve           (STACK*, size_t);
+int     stack_linearize         (STACK*);
 int     stack_unshift           (STACK*, int64_t);
-void    stack_display           (STACK);
+void    stack_display           (struct OML_OUTPUT*, STACK);
 void    stack_clear             (STACK*);
 void    stack_destory           (STACK*);
 void    stack_push_int_array    (STACK*, int64_t*, size_t);
+void    stack_push_digits       (STACK*, int64_t, int64_t);
 int64_t stack_pop               (STACK*);
 int64_t stack_shift             (STACK*);
 int64_t stack_pop_from          (STACK*, size_t);
 int64_t stack_peek              (STACK*);
+void    stack_reverse           (STACK*);
+void    stack_reverse_top       (STACK*, int64_t);
+void    stack_enter             (STACK*, size_t);
+void    stack_leave             (STACK*, size_t);
+void    stack_add_all           (STACK*, int64_t);
+void    stack_mul_all           (STACK*, int64_t);
+void    stack_mod_all           (STACK*, int64_t);
+int64_t stack_sum               (STACK*);
+int64_t stack_product           (STACK*);
+int64_t stack_min               (STACK*);
+int64_t stack_max               (STACK*);
+void    stack_scan              (STACK*);
+void    stack_differences       (STACK*);
+void    stack_stats_add         (STACK_STATS*, STACK_STATS);
+int64_t stack_from_base         (STACK*, int64_t);
 
 /* generic function */
-void    show_help       (char*);
-bool    stdin_remaining (void);
-char*   read_file       (char*, size_t*);
+bool    stdin_remaining (OML*);
 
-#define to_output_base(a, b) to_base(a, OUTPUT_BASE, b)
-double      random_scale    (void);
 int         is_power        (int64_t, int64_t);
 int64_t     ipow            (int64_t, int64_t);
 int64_t     icbrt           (int64_t);
 int64_t     isqrt           (int64_t);
 int64_t     factorial       (int64_t);
-int64_t     random_between  (int64_t, int64_t);
-int64_t*    to_base         (int64_t, int64_t, size_t*);
+bool        is_prime        (int64_t);
+int64_t     random_int      (OML*, int64_t);
+void        random_fill     (OML*, STACK*, int64_t, int64_t);
 
-int     is_valid_in_char    (int);
+// enough for any int64_t in base 2, with its sign
+#define FORMAT_INT_SIZE (66)
+size_t  digit_count     (uint64_t, uint64_t);
+size_t  format_uint     (char*, uint64_t, unsigned);
+size_t  format_int      (char*, int64_t, unsigned);
+
+int     is_valid_in_char    (int, int);
 int     char_to_in_digit    (int);
-void    print_int           (int64_t);
+void    print_int           (OML*, int64_t);
 double  fpart               (double);
-int64_t input_int           (void);
+int64_t input_int           (OML*);
+int64_t input_decimal       (OML*, int64_t*);
 
-/* OML functions */
-OML     OML_init            (char*, size_t);
-OML     OML_exec            (char*, size_t);
+/* library interface: an instance runs its own copy of `code', and shares no
+   state with any other, so instances can run on several threads at once */
+OML*    OML_create          (const char* code, size_t size);
+void    OML_set_output      (OML*, OML_SINK, void*);
+void    OML_set_input       (OML*, OML_SOURCE, void*);
 void    OML_run             (OML*);
+void    OML_reset           (OML*);
+void    OML_flush           (OML*);
+void    OML_seed            (OML*, uint64_t);
+void    OML_set_bigint      (OML*);
+void    OML_display         (OML*, STACK);
+void    OML_destroy         (OML*);
+
+/* OML functions */
 void    OML_diagnostic      (OML*);
-void    OML_exec_cmd        (OML*, char);
+void    OML_report_stats    (OML*, int);
+void    OML_fail            (OML*, const char*);
+void    OML_run_range       (OML*, size_t, size_t);
+void    OML_exec_body       (OML*, size_t, size_t, STACK);
+void    OML_map             (OML*, size_t, size_t);
+void    OML_reduce          (OML*, size_t, size_t);
+void    OML_map_parallel    (OML*, size_t, size_t, STACK*);
+void    OML_run_numbers     (OML*);
+size_t  OML_string_end      (char*, size_t, size_t);
+OML_PROGRAM OML_compile     (char*, size_t);
+void    OML_optimize        (OML_PROGRAM*);
 void    OML_exec_str_stk    (OML*, char*, STACK);
 void    OML_exec_str_args   (OML*, char*, size_t, ...);
 void    OML_exec_str        (OML*, char*);
+
+/* JIT functions */
+struct OML_JIT* OML_jit_init    (OML_PROGRAM*);
+void    OML_jit_destroy     (struct OML_JIT*);
+int     OML_jit_loop        (OML*, size_t);
+bool    OML_jit_body        (OML*, size_t);
+bool    OML_jit_supported   (void);
+
+/* profiler functions */
+struct OML_PROFILE* OML_profile_init    (const OML_PROGRAM*);
+void    OML_profile_destroy (struct OML_PROFILE*);
+void    OML_profile_stop    (struct OML_PROFILE*);
+void    OML_profile_report  (OML*, int);
+bool    OML_profile_save    (OML*, const char*);
+
+/* output functions */
+struct OML_OUTPUT* out_init (void);
+void    out_set_sink        (struct OML_OUTPUT*, OML_SINK, void*);
+void    out_destroy         (struct OML_OUTPUT*);
+void    out_write           (struct OML_OUTPUT*, int, const char*, size_t);
+void    out_char            (struct OML_OUTPUT*, int, char);
+void    out_printf          (struct OML_OUTPUT*, int, const char*, ...);
+void    out_flush           (struct OML_OUTPUT*, int);
+void    out_flush_all       (struct OML_OUTPUT*);
+
+/* input functions */
+struct OML_INPUT* in_init   (struct OML_OUTPUT*);
+void    in_set_source       (struct OML_INPUT*, OML_SOURCE, void*);
+void    in_destroy          (struct OML_INPUT*);
+int     in_peek             (struct OML_INPUT*);
+int     in_char             (struct OML_INPUT*);
+bool    in_int_remaining    (struct OML_INPUT*, int64_t);
+int64_t in_int              (struct OML_INPUT*, int64_t);
+double  in_double           (struct OML_INPUT*);
+size_t  in_take_block       (struct OML_INPUT*, const char**);
+bool    parse_int           (const char**, const char*, int64_t, int64_t*);
+
+/* arena functions */
+struct OML_ARENA* arena_init    (void);
+void*   arena_alloc         (struct OML_ARENA*, size_t);
+void    arena_reset         (struct OML_ARENA*);
+void    arena_destroy       (struct OML_ARENA*);
+size_t  arena_peak          (struct OML_ARENA*);
+
+/* thread pool functions */
+typedef void (*OML_POOL_FN)(void* arg, size_t worker, size_t lo, size_t hi);
+struct OML_POOL* OML_pool_init  (size_t);
+void    OML_pool_destroy    (struct OML_POOL*);
+size_t  OML_pool_workers    (struct OML_POOL*);
+void    OML_pool_run        (struct OML_POOL*, OML_POOL_FN, void*, size_t);
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+// a bump allocator owning the memory of an instance's stacks
+
+#include <stdlib.h>     /* for malloc, free */
+
+#include "OML.h"
+
+// size of the first block of a new arena
+#define ARENA_FIRST_BLOCK   (16 * 1024)
+// alignment of every allocation
+#define ARENA_ALIGN         (16)
+
+/*
+ * Memory is handed out from the newest block by bumping an offset, and is
+ * never freed on its own: a stack that grows takes a new buffer and leaves
+ * its old one behind, which doubling bounds to the size of the new one.
+ * Everything is released at once, either by resetting the arena for reuse
+ * or by destroying it. A reset folds all the blocks into one block large
+ * enough to hold them, so that a workload repeated after a reset does not
+ * need to grow the arena again.
+ */
+typedef struct OML_ARENA_BLOCK {
+    struct OML_ARENA_BLOCK* prev;
+    size_t size, used;
+} OML_ARENA_BLOCK;
+
+typedef struct OML_ARENA {
+    OML_ARENA_BLOCK* block;     /* the newest block, or NULL */
+    size_t capacity;            /* bytes in all blocks */
+    size_t used, peak;          /* bytes handed out since the reset, and most ever */
+} OML_ARENA;
+
+// the block headers are padded so that the memory after them stays aligned
+#define ARENA_HEADER \
+    ((sizeof(OML_ARENA_BLOCK) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static bool arena_add_block(OML_ARENA* arena, size_t size) {
+    OML_ARENA_BLOCK* block = malloc(ARENA_HEADER + size);
+    if(block == NULL) {
+        return false;
+    }
+    block->prev = arena->block;
+    block->size = size;
+    block->used = 0;
+    arena->block = block;
+    arena->capacity += size;
+    return true;
+}
+
+struct OML_ARENA* arena_init(void) {
+    OML_ARENA* arena = malloc(sizeof(OML_ARENA));
+    arena->block = NULL;
+    arena->capacity = arena->used = arena->peak = 0;
+    return arena;
+}
+
+void* arena_alloc(struct OML_ARENA* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    OML_ARENA_BLOCK* block = arena->block;
+    if(block == NULL || block->size - block->used < size) {
+        size_t next = block ? block->size * 2 : ARENA_FIRST_BLOCK;
+        if(!arena_add_block(arena, next > size ? next : size)) {
+            return NULL;
+        }
+        block = arena->block;
+    }
+
+    void* res = (char*) block + ARENA_HEADER + block->used;
+    block->used += size;
+    arena->used += size;
+    if(arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return res;
+}
+
+static void arena_free_blocks(OML_ARENA* arena) {
+    while(arena->block) {
+        OML_ARENA_BLOCK* prev = arena->block->prev;
+        free(arena->block);
+        arena->block = prev;
+    }
+    arena->capacity = 0;
+}
+
+// releases everything allocated from `arena', keeping its memory for reuse
+void arena_reset(struct OML_ARENA* arena) {
+    if(arena->block && arena->block->prev) {
+        size_t capacity = arena->capacity;
+        arena_free_blocks(arena);
+        arena_add_block(arena, capacity);
+    }
+    else if(arena->block) {
+        arena->block->used = 0;
+    }
+    arena->used = 0;
+}
+
+void arena_destroy(struct OML_ARENA* arena) {
+    if(arena == NULL) {
+        return;
+    }
+    arena_free_blocks(arena);
+    free(arena);
+}
+
+// the most bytes `arena' has held at once
+size_t arena_peak(struct OML_ARENA* arena) {
+    return arena->peak;
+}
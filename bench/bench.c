@@ -0,0 +1,373 @@
+/*
+ * the benchmark suite: the programs of bench/corpus.txt run through an OML
+ * binary, and microbenchmarks of the library's hot functions, reported as
+ * JSON with the wall time and the instructions each operation takes; the
+ * instructions are null where the kernel will not count them
+ *   build: make bench/bench
+ *   usage: bench/bench [-b binary] [-c corpus] [-r runs] [-n numbers] [-m count]
+ */
+
+#include "../OML.c"
+
+#include <fcntl.h>                  /* for open */
+#include <linux/perf_event.h>       /* for perf_event_attr */
+#include <sys/ioctl.h>              /* for ioctl */
+#include <sys/syscall.h>            /* for SYS_perf_event_open */
+#include <sys/wait.h>               /* for waitpid */
+#include <time.h>                   /* for clock_gettime */
+#include <unistd.h>                 /* for fork, execv, pipe */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a counter of the user-space instructions of `pid' and the threads it
+// starts, or -1; with `on_exec' it starts counting at the next exec
+static int counter_open(pid_t pid, bool on_exec) {
+    struct perf_event_attr attr = { 0 };
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.enable_on_exec = on_exec;
+    return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+static double counter_read(int fd) {
+    uint64_t count;
+    if(fd < 0 || read(fd, &count, sizeof count) != sizeof count) {
+        return -1;
+    }
+    return count;
+}
+
+// prints a measurement as a JSON value, null if there is none
+static void print_measure(double value) {
+    if(value < 0) {
+        printf("null");
+    }
+    else {
+        printf("%.2f", value);
+    }
+}
+
+static void print_result(bool* first, const char* name, double ns, double instructions) {
+    printf("%s\n    { \"name\": \"%s\", \"ns_per_op\": ", *first ? "" : ",", name);
+    print_measure(ns);
+    printf(", \"instructions_per_op\": ");
+    print_measure(instructions);
+    printf(" }");
+    *first = false;
+}
+
+/* the corpus */
+
+// writes `count' numbers spread over all magnitudes to `path', one a line
+static bool write_numbers(const char* path, size_t count, bool hex) {
+    FILE* file = fopen(path, "w");
+    if(!file) {
+        return false;
+    }
+    uint64_t rng[2];
+    seed(rng, 12345, 67890);
+    for(size_t i = 0; i < count; i++) {
+        uint64_t n = next(rng) >> (1 + next(rng) % 63);
+        fprintf(file, hex ? "%"PRIx64"\n" : "%"PRIu64"\n", n);
+    }
+    return fclose(file) == 0;
+}
+
+// runs `binary' with `flags' over `program', with stdin from `input' or
+// `text', giving the wall time and the instructions, or -1 for either
+static bool run_program(const char* binary, const char* flags, const char* program,
+                        const char* input, const char* text, double* ns, double* instructions) {
+    int go[2], in[2] = { -1, -1 };
+    if(pipe(go) != 0 || (text && pipe(in) != 0)) {
+        return false;
+    }
+    double start = now();
+    pid_t pid = fork();
+    if(pid == 0) {
+        // wait until the parent has the counter ready
+        char c;
+        close(go[1]);
+        if(read(go[0], &c, 1) != 1) {
+            _exit(127);
+        }
+        int fd = text ? in[0] : open(input ? input : "/dev/null", O_RDONLY);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(fd, 0);
+        dup2(null, 1);
+        char* argv[4] = { (char*) binary };
+        size_t argc = 1;
+        if(flags) {
+            argv[argc++] = (char*) flags;
+        }
+        argv[argc++] = (char*) program;
+        argv[argc] = NULL;
+        execv(binary, argv);
+        _exit(127);
+    }
+    int fd = counter_open(pid, true);
+    close(go[0]);
+    write(go[1], "", 1);
+    close(go[1]);
+    if(text) {
+        close(in[0]);
+        write(in[1], text, strlen(text));
+        write(in[1], "\n", 1);
+        close(in[1]);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    *ns = (now() - start) * 1e9;
+    *instructions = counter_read(fd);
+    if(fd >= 0) {
+        close(fd);
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// runs every program of the corpus `runs' times, taking the fastest run
+static void run_corpus(const char* binary, const char* path, size_t runs, const char* numbers,
+                       const char* hex, bool* first) {
+    FILE* file = fopen(path, "r");
+    if(!file) {
+        fprintf(stderr, "bench: no corpus at %s\n", path);
+        return;
+    }
+    char line[4096];
+    while(fgets(line, sizeof line, file)) {
+        line[strcspn(line, "\n")] = '\0';
+        if(line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+        char* fields[4] = { "", "-", "-", "" };
+        char* rest = line;
+        for(size_t i = 0; i < 4 && rest; i++) {
+            fields[i] = rest;
+            rest = strchr(rest, '\t');
+            if(rest) {
+                *rest++ = '\0';
+            }
+        }
+        const char* flags = strcmp(fields[1], "-") ? fields[1] : NULL;
+        const char* input = !strcmp(fields[2], "numbers") ? numbers
+                          : !strcmp(fields[2], "hex") ? hex : NULL;
+        const char* text = fields[2][0] == '=' ? fields[2] + 1 : NULL;
+
+        double best_ns = -1, best_instructions = -1;
+        bool ok = true;
+        for(size_t r = 0; r < runs && ok; r++) {
+            double ns = -1, instructions = -1;
+            ok = run_program(binary, flags, fields[3], input, text, &ns, &instructions);
+            if(best_ns < 0 || ns < best_ns) {
+                best_ns = ns;
+            }
+            if(instructions >= 0 && (best_instructions < 0 || instructions < best_instructions)) {
+                best_instructions = instructions;
+            }
+        }
+        if(!ok) {
+            fprintf(stderr, "bench: %s failed\n", fields[0]);
+            continue;
+        }
+        print_result(first, fields[0], best_ns, best_instructions);
+    }
+    fclose(file);
+}
+
+/* the microbenchmarks, each timing `count' operations after its setup */
+
+typedef struct MICRO_CLOCK {
+    int fd;             /* instruction counter, or -1 */
+    double start, ns, instructions;
+} MICRO_CLOCK;
+
+static void clock_start(MICRO_CLOCK* clock) {
+    if(clock->fd >= 0) {
+        ioctl(clock->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(clock->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock->start = now();
+}
+
+static void clock_stop(MICRO_CLOCK* clock) {
+    clock->ns = (now() - clock->start) * 1e9;
+    if(clock->fd >= 0) {
+        ioctl(clock->fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    clock->instructions = counter_read(clock->fd);
+}
+
+static void discard(void* data, int fd, const char* buf, size_t size) {
+    (void) fd;
+    *(size_t*) data += size + buf[size - 1];
+}
+
+typedef struct TEXT {
+    const char* pos;
+    const char* end;
+} TEXT;
+
+static size_t text_source(void* data, char* buf, size_t size) {
+    TEXT* text = data;
+    size_t left = text->end - text->pos;
+    size = size < left ? size : left;
+    memcpy(buf, text->pos, size);
+    text->pos += size;
+    return size;
+}
+
+// numbers spread over all magnitudes
+static int64_t* numbers_spread(size_t count) {
+    int64_t* numbers = malloc(count * sizeof(int64_t));
+    uint64_t rng[2];
+    seed(rng, 12345, 67890);
+    for(size_t i = 0; i < count; i++) {
+        numbers[i] = (int64_t) (next(rng) >> 1) >> (next(rng) % 63);
+    }
+    return numbers;
+}
+
+static uint64_t micro_push_pop(MICRO_CLOCK* clock, size_t count) {
+    STACK stk = stack_init();
+    uint64_t check = 0;
+    clock_start(clock);
+    for(size_t i = 0; i < count; i++) {
+        stack_push(&stk, i);
+    }
+    for(size_t i = 0; i < count; i++) {
+        check += stack_pop(&stk);
+    }
+    clock_stop(clock);
+    stack_destroy(&stk);
+    return check;
+}
+
+static uint64_t micro_print_int(MICRO_CLOCK* clock, size_t count) {
+    int64_t* numbers = numbers_spread(count);
+    size_t check = 0;
+    OML* inst = OML_create("", 0);
+    OML_set_output(inst, discard, &check);
+    clock_start(clock);
+    for(size_t i = 0; i < count; i++) {
+        print_int(inst, numbers[i]);
+    }
+    OML_flush(inst);
+    clock_stop(clock);
+    OML_destroy(inst);
+    free(numbers);
+    return check;
+}
+
+static uint64_t micro_input_int(MICRO_CLOCK* clock, size_t count) {
+    int64_t* numbers = numbers_spread(count);
+    char* buf = malloc(count * (FORMAT_INT_SIZE + 1));
+    size_t size = 0;
+    for(size_t i = 0; i < count; i++) {
+        size += format_int(buf + size, numbers[i], 10);
+        buf[size++] = '\n';
+    }
+    TEXT text = { buf, buf + size };
+    OML* inst = OML_create("", 0);
+    OML_set_input(inst, text_source, &text);
+    uint64_t check = 0;
+    clock_start(clock);
+    for(size_t i = 0; i < count; i++) {
+        check += input_int(inst);
+    }
+    clock_stop(clock);
+    OML_destroy(inst);
+    free(buf);
+    free(numbers);
+    return check;
+}
+
+// the conversion that to_base once did, for output in bases other than 10
+static uint64_t micro_format_int(MICRO_CLOCK* clock, size_t count) {
+    int64_t* numbers = numbers_spread(count);
+    char buf[FORMAT_INT_SIZE];
+    uint64_t check = 0;
+    clock_start(clock);
+    for(size_t i = 0; i < count; i++) {
+        size_t size = format_int(buf, numbers[i], 7);
+        check += size + buf[size - 1];
+    }
+    clock_stop(clock);
+    free(numbers);
+    return check;
+}
+
+static uint64_t micro_isqrt(MICRO_CLOCK* clock, size_t count) {
+    int64_t* numbers = numbers_spread(count);
+    uint64_t check = 0;
+    clock_start(clock);
+    for(size_t i = 0; i < count; i++) {
+        check += isqrt(numbers[i]);
+    }
+    clock_stop(clock);
+    free(numbers);
+    return check;
+}
+
+static const struct {
+    const char* name;
+    uint64_t (*run)(MICRO_CLOCK*, size_t);
+} MICRO[] = {
+    { "micro_stack_push_pop", micro_push_pop },
+    { "micro_print_int", micro_print_int },
+    { "micro_input_int", micro_input_int },
+    { "micro_format_int_base7", micro_format_int },
+    { "micro_isqrt", micro_isqrt },
+};
+
+static void run_micro(size_t count, bool* first) {
+    MICRO_CLOCK clock = { counter_open(0, false) };
+    for(size_t i = 0; i < sizeof(MICRO) / sizeof(*MICRO); i++) {
+        volatile uint64_t check = MICRO[i].run(&clock, count);
+        (void) check;
+        print_result(first, MICRO[i].name, clock.ns / count,
+                     clock.instructions < 0 ? -1 : clock.instructions / count);
+    }
+    if(clock.fd >= 0) {
+        close(clock.fd);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* binary = "./OML";
+    const char* corpus = "bench/corpus.txt";
+    size_t runs = 3, numbers = 10000000, count = 10000000;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        if(!strcmp(argv[i], "-b"))          binary = argv[i + 1];
+        else if(!strcmp(argv[i], "-c"))     corpus = argv[i + 1];
+        else if(!strcmp(argv[i], "-r"))     runs = strtoul(argv[i + 1], NULL, 10);
+        else if(!strcmp(argv[i], "-n"))     numbers = strtoul(argv[i + 1], NULL, 10);
+        else if(!strcmp(argv[i], "-m"))     count = strtoul(argv[i + 1], NULL, 10);
+    }
+
+    char numbers_path[] = "/tmp/oml-bench-XXXXXX";
+    char hex_path[] = "/tmp/oml-bench-XXXXXX";
+    close(mkstemp(numbers_path));
+    close(mkstemp(hex_path));
+    if(!write_numbers(numbers_path, numbers, false) || !write_numbers(hex_path, numbers, true)) {
+        fprintf(stderr, "bench: cannot write the input numbers\n");
+        return 1;
+    }
+
+    bool first = true;
+    printf("{\n  \"binary\": \"%s\",\n  \"results\": [", binary);
+    run_corpus(binary, corpus, runs, numbers_path, hex_path, &first);
+    run_micro(count, &first);
+    printf("\n  ]\n}\n");
+
+    unlink(numbers_path);
+    unlink(hex_path);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * integer formatting: format_int against the formatting it replaced, which
+ * went through snprintf for bases 10 and 16 and a malloc'd digit array from
+ * log() for the others
+ *   build: cc -O2 -pthread -o format bench/format.c -lm
+ *   usage: ./format [count]
+ */
+
+#include "../OML.c"
+
+#include <time.h>
+
+static int64_t* old_to_base(int64_t n, int64_t base, size_t* out_size) {
+    double ratio = round(log(n) / log(base));
+    *out_size = 1 + ratio;
+    size_t j = *out_size;
+    int64_t* temp = malloc(j * sizeof(int64_t));
+    while(n > 0) {
+        temp[--j] = n % base;
+        n /= base;
+    }
+    if(j) {
+        *out_size -= j;
+        memmove(temp, temp + j, *out_size * sizeof(int64_t));
+    }
+    return temp;
+}
+
+static size_t old_format(char* buf, int64_t n, int base) {
+    if(base == 10) {
+        return sprintf(buf, "%"PRId64, n);
+    }
+    if(base == 16) {
+        return sprintf(buf, "%"PRIx64, n);
+    }
+    size_t size;
+    int64_t* digits = old_to_base(n, base, &size);
+    for(size_t i = 0; i < size; i++) {
+        buf[i] = ALPHABET[digits[i]];
+    }
+    free(digits);
+    return size;
+}
+
+static size_t new_format(char* buf, int64_t n, int base) {
+    return format_int(buf, n, base);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ns per number, and a checksum so the work cannot be dropped
+static double run(size_t (*format)(char*, int64_t, int), int base,
+                  const int64_t* numbers, size_t count, size_t* check) {
+    char buf[FORMAT_INT_SIZE];
+    double start = now();
+    for(size_t i = 0; i < count; i++) {
+        size_t size = format(buf, numbers[i], base);
+        *check += size + buf[size - 1];
+    }
+    return (now() - start) * 1e9 / count;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    int64_t* numbers = malloc(count * sizeof(int64_t));
+    // a spread of magnitudes, from one digit up to the full 63 bits
+    uint64_t rng[2];
+    seed(rng, 12345, 67890);
+    for(size_t i = 0; i < count; i++) {
+        numbers[i] = (int64_t) (next(rng) >> 1) >> (next(rng) % 63);
+        if(numbers[i] == 0) {
+            numbers[i] = 1;
+        }
+    }
+
+    static const int bases[] = { 2, 7, 8, 10, 16, 36 };
+    for(size_t b = 0; b < sizeof(bases) / sizeof(*bases); b++) {
+        size_t old_check = 0, new_check = 0;
+        double old_ns = run(old_format, bases[b], numbers, count, &old_check);
+        double new_ns = run(new_format, bases[b], numbers, count, &new_check);
+        printf("base %2d: old %6.1f ns, new %6.1f ns, %4.1fx%s\n",
+               bases[b], old_ns, new_ns, old_ns / new_ns,
+               old_check == new_check ? "" : " (MISMATCH)");
+    }
+    free(numbers);
+    return 0;
+}
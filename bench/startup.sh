@@ -0,0 +1,21 @@
+#!/bin/sh
+# startup latency: mean wall time of running a trivial program many times
+#   usage: bench/startup.sh [binary] [runs]
+
+OML=${1:-./OML}
+RUNS=${2:-2000}
+
+if [ ! -x "$OML" ]; then
+    echo "startup.sh: no executable at $OML" >&2
+    exit 1
+fi
+
+start=$(date +%s%N)
+i=0
+while [ $i -lt "$RUNS" ]; do
+    "$OML" '1' > /dev/null
+    i=$((i + 1))
+done
+end=$(date +%s%N)
+
+echo "startup: $RUNS runs, $(( (end - start) / RUNS / 1000 )) us per run"
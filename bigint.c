@@ -0,0 +1,739 @@
+// arbitrary-precision integers for the overflow-checked arithmetic of -x
+
+#include <signal.h>     /* for raise, SIGFPE */
+#include <stdlib.h>     /* for malloc, free */
+#include <string.h>     /* for memcpy, memset */
+
+#include "OML.h"
+
+// operands shorter than this many limbs are multiplied directly
+#define BIG_KARATSUBA_CUTOFF    (32)
+// the factorials that still fit in a cell
+#define BIG_FACTORIAL_SMALL     (20)
+
+static const char BIG_DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+/*
+ * With -x, arithmetic checks for overflow. A cell holds its own value while
+ * that is in [-2^62, 2^63); a result outside is promoted to a big number in
+ * the big arena of the instance, and the cell holds INT64_MIN plus its
+ * address over 8, which falls in the range no value then uses. A big number
+ * is never a value a cell could hold, so every value has one form, and a
+ * big number never changes once made. They last as long as the instance,
+ * since variables and registers keep them across runs.
+ */
+typedef struct OML_BIG {
+    size_t size;            /* limbs used; the top one is never 0 */
+    bool negative;
+    uint32_t limbs[];       /* the magnitude, least significant first */
+} OML_BIG;
+
+#define BIG_SMALL_MIN   (-(INT64_C(1) << 62))
+#define BIG_IS(cell)    ((cell) < BIG_SMALL_MIN)
+
+static inline OML_BIG* big_of(int64_t cell) {
+    return (OML_BIG*) (((uint64_t) cell - (uint64_t) INT64_MIN) << 3);
+}
+
+// a number as a sign and magnitude, whether it is big or held in a cell
+typedef struct BIG_VIEW {
+    const uint32_t* limbs;
+    size_t size;
+    bool negative;
+    uint32_t small[2];      /* the limbs of a value held in a cell */
+} BIG_VIEW;
+
+static void big_view(int64_t cell, BIG_VIEW* view) {
+    if(BIG_IS(cell)) {
+        OML_BIG* big = big_of(cell);
+        view->limbs = big->limbs;
+        view->size = big->size;
+        view->negative = big->negative;
+        return;
+    }
+    uint64_t mag = cell < 0 ? -(uint64_t) cell : (uint64_t) cell;
+    view->small[0] = mag;
+    view->small[1] = mag >> 32;
+    view->limbs = view->small;
+    view->size = mag >> 32 ? 2 : mag ? 1 : 0;
+    view->negative = cell < 0;
+}
+
+// the cell for the number with `size' limbs in `limbs', and sign `negative'
+static int64_t big_make(OML* inst, const uint32_t* limbs, size_t size, bool negative) {
+    while(size > 0 && limbs[size - 1] == 0) {
+        size--;
+    }
+    if(size <= 2) {
+        uint64_t mag = size == 0 ? 0 : size == 1 ? limbs[0]
+                     : limbs[0] | (uint64_t) limbs[1] << 32;
+        if(!negative && mag <= INT64_MAX) {
+            return mag;
+        }
+        if(negative && mag <= (uint64_t) 1 << 62) {
+            return -(int64_t) mag;
+        }
+    }
+    if(inst->big_arena == NULL) {
+        inst->big_arena = arena_init();
+    }
+    OML_BIG* big = arena_alloc(inst->big_arena, sizeof(OML_BIG) + size * sizeof(uint32_t));
+    if(big == NULL) {
+        OML_fail(inst, "out of memory for a big number");
+    }
+    big->size = size;
+    big->negative = negative;
+    memcpy(big->limbs, limbs, size * sizeof(uint32_t));
+    return INT64_MIN + (int64_t) ((uintptr_t) big >> 3);
+}
+
+// the cell for `n', a plain value that may lie in the range of big numbers,
+// as when a command whose result wraps made it or it was read as input
+static int64_t big_from_int(OML* inst, int64_t n) {
+    if(!BIG_IS(n)) {
+        return n;
+    }
+    uint64_t mag = -(uint64_t) n;
+    uint32_t limbs[2] = { (uint32_t) mag, (uint32_t) (mag >> 32) };
+    return big_make(inst, limbs, 2, true);
+}
+
+// the value of `n' as a cell, for the commands that work on 64 bits; a big
+// number that does not fit leaves the run
+static int64_t big_to_int(OML* inst, int64_t n) {
+    if(!BIG_IS(n)) {
+        return n;
+    }
+    BIG_VIEW v;
+    big_view(n, &v);
+    uint64_t mag = v.size == 0 ? 0 : v.size == 1 ? v.limbs[0]
+                 : v.limbs[0] | (uint64_t) v.limbs[1] << 32;
+    if(v.size > 2 || mag > (uint64_t) INT64_MAX + v.negative) {
+        OML_fail(inst, "number too big for a 64-bit command");
+    }
+    return v.negative ? (int64_t) -mag : (int64_t) mag;
+}
+
+static void* big_scratch(OML* inst, size_t size) {
+    void* res = malloc(size ? size : 1);
+    if(res == NULL) {
+        OML_fail(inst, "out of memory for a big number");
+    }
+    return res;
+}
+
+/* magnitudes: limb arrays, least significant first, possibly with zeros on top */
+
+static int mag_compare(const uint32_t* a, size_t an, const uint32_t* b, size_t bn) {
+    while(an > 0 && a[an - 1] == 0) {
+        an--;
+    }
+    while(bn > 0 && b[bn - 1] == 0) {
+        bn--;
+    }
+    if(an != bn) {
+        return an < bn ? -1 : 1;
+    }
+    while(an-- > 0) {
+        if(a[an] != b[an]) {
+            return a[an] < b[an] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// r += x for rn >= xn, giving the carry out of the top of r
+static uint32_t mag_add_to(uint32_t* r, size_t rn, const uint32_t* x, size_t xn) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for(; i < xn; i++) {
+        carry += (uint64_t) r[i] + x[i];
+        r[i] = carry;
+        carry >>= 32;
+    }
+    for(; carry && i < rn; i++) {
+        carry += r[i];
+        r[i] = carry;
+        carry >>= 32;
+    }
+    return carry;
+}
+
+// r -= x for rn >= xn, giving the borrow out of the top of r
+static uint32_t mag_sub_from(uint32_t* r, size_t rn, const uint32_t* x, size_t xn) {
+    int64_t borrow = 0;
+    size_t i = 0;
+    for(; i < xn; i++) {
+        borrow += (int64_t) r[i] - x[i];
+        r[i] = borrow;
+        borrow >>= 32;
+    }
+    for(; borrow && i < rn; i++) {
+        borrow += r[i];
+        r[i] = borrow;
+        borrow >>= 32;
+    }
+    return borrow != 0;
+}
+
+static void mag_mul_basic(uint32_t* r, const uint32_t* a, size_t an, const uint32_t* b, size_t bn) {
+    memset(r, 0, (an + bn) * sizeof(uint32_t));
+    for(size_t i = 0; i < bn; i++) {
+        uint64_t carry = 0;
+        for(size_t j = 0; j < an; j++) {
+            carry += (uint64_t) a[j] * b[i] + r[i + j];
+            r[i + j] = carry;
+            carry >>= 32;
+        }
+        r[i + an] = carry;
+    }
+}
+
+/*
+ * r = a * b, filling all an + bn limbs of r. Long operands are split in
+ * halves by Karatsuba's method, which makes three half-size products out of
+ * the four of the schoolbook method: with a = a1 B + a0 and b = b1 B + b0,
+ * the middle term a1 b0 + a0 b1 is (a0 + a1)(b0 + b1) - a0 b0 - a1 b1.
+ * Operands of very different lengths are multiplied in slices of the
+ * shorter.
+ */
+static void mag_mul(uint32_t* r, const uint32_t* a, size_t an, const uint32_t* b, size_t bn) {
+    if(an < bn) {
+        const uint32_t* t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if(bn < BIG_KARATSUBA_CUTOFF) {
+        mag_mul_basic(r, a, an, b, bn);
+        return;
+    }
+    if(an >= 2 * bn) {
+        memset(r, 0, (an + bn) * sizeof(uint32_t));
+        uint32_t* part = malloc(2 * bn * sizeof(uint32_t));
+        for(size_t i = 0; i < an; i += bn) {
+            size_t n = an - i < bn ? an - i : bn;
+            mag_mul(part, a + i, n, b, bn);
+            mag_add_to(r + i, an + bn - i, part, n + bn);
+        }
+        free(part);
+        return;
+    }
+
+    // bn > an / 2 >= half, so every part is non-empty
+    size_t half = an / 2;
+    size_t high = an + bn - 2 * half;
+    mag_mul(r, a, half, b, half);
+    mag_mul(r + 2 * half, a + half, an - half, b + half, bn - half);
+
+    size_t sa = an - half + 1;
+    size_t sb = (bn - half > half ? bn - half : half) + 1;
+    uint32_t* sums = malloc((sa + sb + sa + sb) * sizeof(uint32_t));
+    uint32_t* a_sum = sums;
+    uint32_t* b_sum = sums + sa;
+    uint32_t* mid = sums + sa + sb;
+    memset(a_sum, 0, (sa + sb) * sizeof(uint32_t));
+    memcpy(a_sum, a + half, (an - half) * sizeof(uint32_t));
+    mag_add_to(a_sum, sa, a, half);
+    memcpy(b_sum, b, half * sizeof(uint32_t));
+    mag_add_to(b_sum, sb, b + half, bn - half);
+
+    mag_mul(mid, a_sum, sa, b_sum, sb);
+    mag_sub_from(mid, sa + sb, r, 2 * half);
+    mag_sub_from(mid, sa + sb, r + 2 * half, high);
+    // what is left fits above the low half of r
+    size_t mid_size = sa + sb < half + high ? sa + sb : half + high;
+    mag_add_to(r + half, half + high, mid, mid_size);
+    free(sums);
+}
+
+// q = a / d over n limbs, giving a % d
+static uint32_t mag_div_small(uint32_t* q, const uint32_t* a, size_t n, uint32_t d) {
+    uint64_t rem = 0;
+    while(n-- > 0) {
+        uint64_t cur = rem << 32 | a[n];
+        q[n] = cur / d;
+        rem = cur % d;
+    }
+    return rem;
+}
+
+/*
+ * q = a / b and r = a % b by Knuth's algorithm D, for bn >= 2 and a top
+ * limb of b that is not 0; q gets an - bn + 1 limbs and r gets bn. Each
+ * quotient limb is estimated from the top two limbs of what is left, after
+ * shifting both so that the top bit of b is set, which makes the estimate at
+ * most 2 too large.
+ */
+static void mag_divmod(uint32_t* q, uint32_t* r, const uint32_t* a, size_t an,
+        const uint32_t* b, size_t bn) {
+    int shift = __builtin_clz(b[bn - 1]);
+    uint32_t* vn = malloc((bn + an + 1) * sizeof(uint32_t));
+    uint32_t* un = vn + bn;
+    for(size_t i = bn - 1; i > 0; i--) {
+        vn[i] = b[i] << shift | (uint32_t) ((uint64_t) b[i - 1] >> (32 - shift));
+    }
+    vn[0] = b[0] << shift;
+    un[an] = (uint64_t) a[an - 1] >> (32 - shift);
+    for(size_t i = an - 1; i > 0; i--) {
+        un[i] = a[i] << shift | (uint32_t) ((uint64_t) a[i - 1] >> (32 - shift));
+    }
+    un[0] = a[0] << shift;
+
+    for(size_t j = an - bn + 1; j-- > 0;) {
+        uint64_t top = (uint64_t) un[j + bn] << 32 | un[j + bn - 1];
+        uint64_t qhat = top / vn[bn - 1];
+        uint64_t rhat = top % vn[bn - 1];
+        while(qhat >> 32 || qhat * vn[bn - 2] > (rhat << 32 | un[j + bn - 2])) {
+            qhat--;
+            rhat += vn[bn - 1];
+            if(rhat >> 32) {
+                break;
+            }
+        }
+        // un[j..j+bn] -= qhat * vn
+        int64_t borrow = 0, t;
+        for(size_t i = 0; i < bn; i++) {
+            uint64_t p = qhat * vn[i];
+            t = un[i + j] - borrow - (p & 0xffffffff);
+            un[i + j] = t;
+            borrow = (p >> 32) - (t >> 32);
+        }
+        t = un[j + bn] - borrow;
+        un[j + bn] = t;
+        q[j] = qhat;
+        if(t < 0) {
+            // the estimate was one too large; add back
+            q[j]--;
+            uint64_t carry = 0;
+            for(size_t i = 0; i < bn; i++) {
+                carry += (uint64_t) un[i + j] + vn[i];
+                un[i + j] = carry;
+                carry >>= 32;
+            }
+            un[j + bn] += carry;
+        }
+    }
+    for(size_t i = 0; i < bn; i++) {
+        r[i] = un[i] >> shift | (uint32_t) ((uint64_t) un[i + 1] << (32 - shift));
+    }
+    free(vn);
+}
+
+/* operations on cells: inline checks for results that stay in a cell, with
+   the general case out of line */
+
+static int64_t big_add_slow(OML* inst, int64_t a, int64_t b, bool subtract) {
+    BIG_VIEW x, y;
+    big_view(a, &x);
+    big_view(b, &y);
+    bool y_negative = y.negative != subtract;
+    size_t size = (x.size > y.size ? x.size : y.size) + 1;
+    uint32_t* r = big_scratch(inst, size * sizeof(uint32_t));
+    bool negative;
+    if(x.negative == y_negative) {
+        memset(r, 0, size * sizeof(uint32_t));
+        memcpy(r, x.limbs, x.size * sizeof(uint32_t));
+        mag_add_to(r, size, y.limbs, y.size);
+        negative = x.negative;
+    }
+    else {
+        // the difference of the magnitudes, with the sign of the larger
+        const BIG_VIEW* big = &x;
+        const BIG_VIEW* small = &y;
+        negative = x.negative;
+        if(mag_compare(x.limbs, x.size, y.limbs, y.size) < 0) {
+            big = &y;
+            small = &x;
+            negative = y_negative;
+        }
+        memset(r, 0, size * sizeof(uint32_t));
+        memcpy(r, big->limbs, big->size * sizeof(uint32_t));
+        mag_sub_from(r, size, small->limbs, small->size);
+    }
+    int64_t res = big_make(inst, r, size, negative);
+    free(r);
+    return res;
+}
+
+static inline int64_t big_add(OML* inst, int64_t a, int64_t b) {
+    int64_t res;
+    if(__builtin_expect(!BIG_IS(a) && !BIG_IS(b) && !__builtin_add_overflow(a, b, &res)
+            && !BIG_IS(res), 1)) {
+        return res;
+    }
+    return big_add_slow(inst, a, b, false);
+}
+
+static inline int64_t big_sub(OML* inst, int64_t a, int64_t b) {
+    int64_t res;
+    if(__builtin_expect(!BIG_IS(a) && !BIG_IS(b) && !__builtin_sub_overflow(a, b, &res)
+            && !BIG_IS(res), 1)) {
+        return res;
+    }
+    return big_add_slow(inst, a, b, true);
+}
+
+static inline int64_t big_negate(OML* inst, int64_t a) {
+    // values above 2^62 have no negation in a cell
+    if(__builtin_expect(!BIG_IS(a) && a <= -BIG_SMALL_MIN, 1)) {
+        return -a;
+    }
+    return big_add_slow(inst, 0, a, true);
+}
+
+static int64_t big_mul_slow(OML* inst, int64_t a, int64_t b) {
+    BIG_VIEW x, y;
+    big_view(a, &x);
+    big_view(b, &y);
+    if(x.size == 0 || y.size == 0) {
+        return 0;
+    }
+    uint32_t* r = big_scratch(inst, (x.size + y.size) * sizeof(uint32_t));
+    mag_mul(r, x.limbs, x.size, y.limbs, y.size);
+    int64_t res = big_make(inst, r, x.size + y.size, x.negative != y.negative);
+    free(r);
+    return res;
+}
+
+static inline int64_t big_mul(OML* inst, int64_t a, int64_t b) {
+    int64_t res;
+    if(__builtin_expect(!BIG_IS(a) && !BIG_IS(b) && !__builtin_mul_overflow(a, b, &res)
+            && !BIG_IS(res), 1)) {
+        return res;
+    }
+    return big_mul_slow(inst, a, b);
+}
+
+// a / b and a % b, truncating toward 0 as C does
+static void big_divmod_slow(OML* inst, int64_t a, int64_t b, int64_t* quot, int64_t* rem) {
+    BIG_VIEW x, y;
+    big_view(a, &x);
+    big_view(b, &y);
+    if(y.size == 0) {
+        raise(SIGFPE);
+        return;
+    }
+    if(mag_compare(x.limbs, x.size, y.limbs, y.size) < 0) {
+        *quot = 0;
+        *rem = a;
+        return;
+    }
+    uint32_t* q = big_scratch(inst, (x.size + y.size) * sizeof(uint32_t));
+    uint32_t* r = q + x.size;
+    if(y.size == 1) {
+        r[0] = mag_div_small(q, x.limbs, x.size, y.limbs[0]);
+    }
+    else {
+        mag_divmod(q, r, x.limbs, x.size, y.limbs, y.size);
+    }
+    *quot = big_make(inst, q, x.size - y.size + 1, x.negative != y.negative);
+    *rem = big_make(inst, r, y.size, x.negative);
+    free(q);
+}
+
+static inline void big_divmod(OML* inst, int64_t a, int64_t b, int64_t* quot, int64_t* rem) {
+    // neither can overflow, as |a| <= 2^62
+    if(__builtin_expect(!BIG_IS(a) && !BIG_IS(b), 1)) {
+        *quot = a / b;
+        *rem = a % b;
+        return;
+    }
+    big_divmod_slow(inst, a, b, quot, rem);
+}
+
+static int big_compare_slow(int64_t a, int64_t b) {
+    BIG_VIEW x, y;
+    big_view(a, &x);
+    big_view(b, &y);
+    if(x.negative != y.negative) {
+        return x.negative ? -1 : 1;
+    }
+    int order = mag_compare(x.limbs, x.size, y.limbs, y.size);
+    return x.negative ? -order : order;
+}
+
+// below 0, 0 or above 0 as a is less than, equal to or greater than b
+static inline int big_compare(int64_t a, int64_t b) {
+    if(__builtin_expect(!BIG_IS(a) && !BIG_IS(b), 1)) {
+        return (a > b) - (a < b);
+    }
+    return big_compare_slow(a, b);
+}
+
+// the product of lo..hi, split in halves so that the operands of each
+// multiplication are of a similar size
+static int64_t big_product(OML* inst, int64_t lo, int64_t hi) {
+    if(hi - lo < 8) {
+        int64_t res = lo;
+        for(int64_t i = lo + 1; i <= hi; i++) {
+            res = big_mul(inst, res, i);
+        }
+        return res;
+    }
+    int64_t mid = lo + (hi - lo) / 2;
+    return big_mul(inst, big_product(inst, lo, mid), big_product(inst, mid + 1, hi));
+}
+
+static int64_t big_factorial(OML* inst, int64_t n) {
+    if(BIG_IS(n)) {
+        if(big_of(n)->negative) {
+            return 0;
+        }
+        OML_fail(inst, "factorial too large");
+    }
+    if(n <= BIG_FACTORIAL_SMALL) {
+        return factorial(n);
+    }
+    return big_product(inst, 1, n);
+}
+
+static int64_t big_pow(OML* inst, int64_t base, int64_t exp) {
+    if(base == 0 || base == 1) {
+        return exp == 0 ? 1 : base;
+    }
+    if(base == -1) {
+        return BIG_IS(exp) ? (big_of(exp)->limbs[0] & 1 ? -1 : 1) : exp & 1 ? -1 : 1;
+    }
+    // |base| >= 2, so any other power below 1 truncates to 0
+    if(exp < 0 && !BIG_IS(exp)) {
+        return 0;
+    }
+    if(BIG_IS(exp)) {
+        if(big_of(exp)->negative) {
+            return 0;
+        }
+        OML_fail(inst, "power too large");
+    }
+    int64_t res = 1;
+    while(exp) {
+        if(exp & 1) {
+            res = big_mul(inst, res, base);
+        }
+        exp >>= 1;
+        if(exp) {
+            base = big_mul(inst, base, base);
+        }
+    }
+    return res;
+}
+
+// x followed by the decimal digits of y, as `T' makes it
+static int64_t big_concat(OML* inst, int64_t x, int64_t y) {
+    int64_t pow = 10;
+    while(big_compare(y, pow) >= 0) {
+        pow = big_mul(inst, pow, 10);
+    }
+    return big_add(inst, big_mul(inst, x, pow), y);
+}
+
+// powers of a base used to split a number for conversion: levels[k] is
+// chunk^(2^k), which has digits << k digits
+typedef struct BIG_RADIX {
+    unsigned base, digits;
+    uint32_t chunk;         /* the largest power of the base in a limb */
+    size_t count;
+    struct { uint32_t* limbs; size_t size; } levels[64];
+} BIG_RADIX;
+
+// q = a / chunk, giving a % chunk; a constant divisor becomes a multiply
+static inline uint32_t big_div_chunk(uint32_t* q, const uint32_t* a, size_t n, uint32_t chunk) {
+    return chunk == 1000000000 ? mag_div_small(q, a, n, 1000000000) : mag_div_small(q, a, n, chunk);
+}
+
+/*
+ * Writes the digits of the n-limb magnitude `a', which it may change, so
+ * that they end before `end', and gives where they start. If `width' is not
+ * 0, leading zeros pad the digits to exactly that many. Short numbers are
+ * divided by the chunk, giving that many digits per pass over the number;
+ * long ones are split by the largest level below them into a high and a low
+ * half, which are written separately, so that most of the work is spent on
+ * a few long divisions rather than on many short ones.
+ */
+static char* big_digits(OML* inst, char* end, uint32_t* a, size_t n,
+        const BIG_RADIX* radix, size_t level, size_t width) {
+    char* pos = end;
+    while(n > 0 && a[n - 1] == 0) {
+        n--;
+    }
+    while(level > 0 && radix->levels[level].size > n) {
+        level--;
+    }
+    if(level == 0 || n < BIG_KARATSUBA_CUTOFF) {
+        while(n > 0) {
+            uint32_t part = big_div_chunk(a, a, n, radix->chunk);
+            while(n > 0 && a[n - 1] == 0) {
+                n--;
+            }
+            // every chunk but the leading one is padded with zeros
+            for(unsigned i = 0; i < radix->digits && (n > 0 || part > 0); i++) {
+                *--pos = BIG_DIGITS[part % radix->base];
+                part /= radix->base;
+            }
+        }
+    }
+    else {
+        const uint32_t* p = radix->levels[level].limbs;
+        size_t pn = radix->levels[level].size;
+        size_t low_width = (size_t) radix->digits << level;
+        if(mag_compare(a, n, p, pn) < 0) {
+            return big_digits(inst, end, a, n, radix, level - 1, width);
+        }
+        uint32_t* q = big_scratch(inst, (n + 1) * sizeof(uint32_t));
+        uint32_t* r = q + n - pn + 1;
+        mag_divmod(q, r, a, n, p, pn);
+        pos = big_digits(inst, pos, r, pn, radix, level - 1, low_width);
+        pos = big_digits(inst, pos, q, n - pn + 1, radix, level - 1,
+                         width > low_width ? width - low_width : 0);
+        free(q);
+    }
+    while(width > (size_t) (end - pos)) {
+        *--pos = '0';
+    }
+    return pos;
+}
+
+/*
+ * Writes the digits of the magnitude of a big number in `base'. Bases that
+ * are powers of 2 take their digits straight from the bits; the others are
+ * converted by big_digits.
+ */
+static void big_write_digits(OML* inst, int fd, const BIG_VIEW* v, unsigned base) {
+    size_t bits = 32 * v->size - __builtin_clz(v->limbs[v->size - 1]);
+    if((base & (base - 1)) == 0) {
+        unsigned shift = __builtin_ctz(base);
+        size_t count = (bits + shift - 1) / shift;
+        char* buf = big_scratch(inst, count);
+        for(size_t i = 0; i < count; i++) {
+            size_t bit = (count - 1 - i) * shift;
+            uint64_t word = v->limbs[bit / 32];
+            if(bit / 32 + 1 < v->size) {
+                word |= (uint64_t) v->limbs[bit / 32 + 1] << 32;
+            }
+            buf[i] = BIG_DIGITS[(word >> bit % 32) & (base - 1)];
+        }
+        out_write(inst->out, fd, buf, count);
+        free(buf);
+        return;
+    }
+
+    BIG_RADIX radix = { base, 1, base, 1, { { NULL, 1 } } };
+    while((uint64_t) radix.chunk * base <= UINT32_MAX) {
+        radix.chunk *= base;
+        radix.digits++;
+    }
+    radix.levels[0].limbs = &radix.chunk;
+    // each level is the square of the one before, up to half the number
+    while(radix.levels[radix.count - 1].size * 2 <= v->size) {
+        size_t prev = radix.count - 1;
+        size_t size = 2 * radix.levels[prev].size;
+        uint32_t* limbs = big_scratch(inst, size * sizeof(uint32_t));
+        mag_mul(limbs, radix.levels[prev].limbs, radix.levels[prev].size,
+                radix.levels[prev].limbs, radix.levels[prev].size);
+        while(limbs[size - 1] == 0) {
+            size--;
+        }
+        radix.levels[radix.count].limbs = limbs;
+        radix.levels[radix.count].size = size;
+        radix.count++;
+    }
+
+    // at least log2(base) bits per digit
+    size_t max_digits = bits / (31 - __builtin_clz(base)) + radix.digits;
+    char* buf = big_scratch(inst, max_digits);
+    uint32_t* rest = big_scratch(inst, v->size * sizeof(uint32_t));
+    memcpy(rest, v->limbs, v->size * sizeof(uint32_t));
+    char* end = buf + max_digits;
+    char* pos = big_digits(inst, end, rest, v->size, &radix, radix.count - 1, 0);
+    out_write(inst->out, fd, pos, end - pos);
+    free(rest);
+    free(buf);
+    for(size_t k = 1; k < radix.count; k++) {
+        free(radix.levels[k].limbs);
+    }
+}
+
+// writes a big number in `base', with a leading - if it is negative
+static void big_write(OML* inst, int fd, int64_t n, unsigned base) {
+    BIG_VIEW v;
+    big_view(n, &v);
+    if(v.negative) {
+        out_char(inst->out, fd, '-');
+    }
+    big_write_digits(inst, fd, &v, base);
+}
+
+/*
+ * The commands under OML_set_bigint whose results wrap at 64 bits rather
+ * than being checked: the bitwise ones, `a', `u', `v', `ed' and the random
+ * numbers. They take big numbers that fit in 64 bits as those values, and
+ * leave the run for bigger ones. Their results are left as they wrap, but
+ * made big numbers where they fall in the range of big numbers, so that
+ * none is taken for one.
+ */
+static void big_wrapped(OML* inst, STACK* stk, int op) {
+    int64_t a, b, res = 0;
+    switch(op) {
+        case OP_COMPLEMENT:
+            res = ~big_to_int(inst, stack_pop(stk));
+            break;
+        case OP_AND:
+            b = big_to_int(inst, stack_pop(stk));
+            a = big_to_int(inst, stack_pop(stk));
+            res = a & b;
+            break;
+        case OP_OR:
+            b = big_to_int(inst, stack_pop(stk));
+            a = big_to_int(inst, stack_pop(stk));
+            res = a | b;
+            break;
+        case OP_XOR:
+            b = big_to_int(inst, stack_pop(stk));
+            a = big_to_int(inst, stack_pop(stk));
+            res = a ^ b;
+            break;
+        case OP_FLIP_BIT:
+            b = big_to_int(inst, stack_pop(stk));
+            a = big_to_int(inst, stack_pop(stk));
+            res = a ^ (1ull << b);
+            break;
+        case OP_FROM_BINARY:
+        case OP_FROM_BASE:
+            for(size_t i = 0; i < stk->size; i++) {
+                STACK_AT(stk, i) = big_to_int(inst, STACK_AT(stk, i));
+            }
+            res = stack_from_base(stk, op == OP_FROM_BINARY ? 2 : inst->output_base);
+            break;
+        case OP_RANDOM:
+            res = random_int(inst, big_to_int(inst, stack_pop(stk)));
+            break;
+        case OP_RANDOM_FILL: {
+            b = big_to_int(inst, stack_pop(stk));
+            a = big_to_int(inst, stack_pop(stk));
+            size_t start = stk->size;
+            random_fill(inst, stk, b, a);
+            for(size_t i = start; i < stk->size; i++) {
+                STACK_AT(stk, i) = big_from_int(inst, STACK_AT(stk, i));
+            }
+            return;
+        }
+        case OP_INPUT_DECIMAL:
+            res = input_decimal(inst, &b);
+            stack_push(stk, big_from_int(inst, res));
+            stack_push(stk, b);
+            return;
+    }
+    stack_push(stk, big_from_int(inst, res));
+}
+
+// prints a big number as print_int prints a cell
+static void big_print(OML* inst, int64_t n) {
+    if(2 <= inst->output_base && inst->output_base <= 36) {
+        big_write(inst, 1, n, inst->output_base);
+        return;
+    }
+    out_printf(inst->out, 2, "No output for base %i: ", inst->output_base);
+    big_write(inst, 2, n, 10);
+}
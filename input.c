@@ -0,0 +1,260 @@
+// buffered input shared by every command that reads stdin
+
+#include <ctype.h>      /* for isdigit */
+#include <errno.h>      /* for errno, EINTR */
+#include <stdio.h>      /* for EOF */
+#include <stdlib.h>     /* for malloc, calloc, free, strtod */
+#include <string.h>     /* for memmove */
+#include <unistd.h>     /* for read */
+
+#include "OML.h"
+
+#define IN_BUFFER_SIZE  (1024 * 1024)
+// longest decimal accepted by in_double
+#define IN_DOUBLE_SIZE  (128)
+
+/*
+ * stdin is read in large blocks straight from its descriptor, or from a
+ * source the embedder gives, and every command of an instance takes its
+ * characters from the instance's one buffer, so the numbers, lines and
+ * characters a program reads stay in order. The buffer is only allocated on
+ * the first read. Whatever the instance has written before a read that could
+ * block, such as a prompt, is flushed first. End of input is sticky: once a
+ * read gives nothing, the input is not read again.
+ */
+typedef struct OML_INPUT {
+    char* data;
+    size_t pos, end;
+    bool eof;
+    OML_SOURCE source;  /* where input comes from, or NULL for read() of stdin */
+    void* source_data;
+    struct OML_OUTPUT* out;     /* flushed before reading */
+} OML_INPUT;
+
+// the value of each digit character in any base up to 36, or 36 if none
+static const unsigned char IN_DIGITS[256] = {
+    [0 ... 255] = 36,
+    ['0'] = 0,  ['1'] = 1,  ['2'] = 2,  ['3'] = 3,  ['4'] = 4,
+    ['5'] = 5,  ['6'] = 6,  ['7'] = 7,  ['8'] = 8,  ['9'] = 9,
+    ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+    ['g'] = 16, ['h'] = 17, ['i'] = 18, ['j'] = 19, ['k'] = 20, ['l'] = 21,
+    ['m'] = 22, ['n'] = 23, ['o'] = 24, ['p'] = 25, ['q'] = 26, ['r'] = 27,
+    ['s'] = 28, ['t'] = 29, ['u'] = 30, ['v'] = 31, ['w'] = 32, ['x'] = 33,
+    ['y'] = 34, ['z'] = 35,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+    ['G'] = 16, ['H'] = 17, ['I'] = 18, ['J'] = 19, ['K'] = 20, ['L'] = 21,
+    ['M'] = 22, ['N'] = 23, ['O'] = 24, ['P'] = 25, ['Q'] = 26, ['R'] = 27,
+    ['S'] = 28, ['T'] = 29, ['U'] = 30, ['V'] = 31, ['W'] = 32, ['X'] = 33,
+    ['Y'] = 34, ['Z'] = 35,
+};
+
+struct OML_INPUT* in_init(struct OML_OUTPUT* out) {
+    OML_INPUT* in = calloc(1, sizeof(OML_INPUT));
+    in->out = out;
+    return in;
+}
+
+// takes all later input from `source' instead of stdin
+void in_set_source(struct OML_INPUT* in, OML_SOURCE source, void* data) {
+    in->source = source;
+    in->source_data = data;
+    in->pos = in->end = 0;
+    in->eof = false;
+}
+
+void in_destroy(struct OML_INPUT* in) {
+    if(in == NULL) {
+        return;
+    }
+    free(in->data);
+    free(in);
+}
+
+// reads more input after what is buffered; false at the end of input
+static bool in_read(OML_INPUT* in) {
+    if(in->eof) {
+        return false;
+    }
+    if(in->data == NULL) {
+        in->data = malloc(IN_BUFFER_SIZE);
+    }
+    out_flush_all(in->out);
+    if(in->source) {
+        size_t n = in->source(in->source_data, in->data + in->end, IN_BUFFER_SIZE - in->end);
+        in->end += n;
+        in->eof = n == 0;
+        return n > 0;
+    }
+    while(true) {
+        ssize_t n = read(0, in->data + in->end, IN_BUFFER_SIZE - in->end);
+        if(n > 0) {
+            in->end += n;
+            return true;
+        }
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        in->eof = true;
+        return false;
+    }
+}
+
+// refills the empty buffer; false at the end of input
+static bool in_fill(OML_INPUT* in) {
+    in->pos = in->end = 0;
+    return in_read(in);
+}
+
+// the next character of stdin without taking it, or EOF
+int in_peek(struct OML_INPUT* in) {
+    if(in->pos == in->end && !in_fill(in)) {
+        return EOF;
+    }
+    return (unsigned char) in->data[in->pos];
+}
+
+int in_char(struct OML_INPUT* in) {
+    int c = in_peek(in);
+    if(c != EOF) {
+        in->pos++;
+    }
+    return c;
+}
+
+// the characters isspace() accepts in the C locale
+static inline bool in_is_space(unsigned char c) {
+    return c == ' ' || (unsigned char) (c - '\t') <= '\r' - '\t';
+}
+
+static void in_skip_space(OML_INPUT* in) {
+    do {
+        while(in->pos < in->end && in_is_space(in->data[in->pos])) {
+            in->pos++;
+        }
+    } while(in->pos == in->end && in_fill(in));
+}
+
+// whether a number in `base' is next after any whitespace
+bool in_int_remaining(struct OML_INPUT* in, int64_t base) {
+    in_skip_space(in);
+    int c = in_peek(in);
+    return c == '-' || c == '+' || (c != EOF && IN_DIGITS[c] < base);
+}
+
+// adds the digits in `base' at the start of [pos, end) to `*value', and
+// gives the position after them
+static inline const unsigned char* in_digits(const unsigned char* pos,
+        const unsigned char* end, int64_t base, uint64_t* value) {
+    uint64_t res = *value;
+    unsigned digit;
+    if(base == 10) {
+        while(pos < end && (digit = *pos - '0') < 10) {
+            res = res * 10 + digit;
+            pos++;
+        }
+    }
+    else {
+        while(pos < end && (digit = IN_DIGITS[*pos]) < base) {
+            res = res * base + digit;
+            pos++;
+        }
+    }
+    *value = res;
+    return pos;
+}
+
+/*
+ * Reads an integer in `base' after any whitespace: an optional sign, then
+ * digits of either case, stopping at the first character that is not one.
+ * Gives 0 if there are no digits. Numbers too large for 64 bits wrap.
+ */
+int64_t in_int(struct OML_INPUT* in, int64_t base) {
+    in_skip_space(in);
+    int c = in_peek(in);
+    bool negative = c == '-';
+    if(c == '-' || c == '+') {
+        in->pos++;
+    }
+
+    uint64_t value = 0;
+    do {
+        // scan what is buffered with no further checks, then refill
+        const unsigned char* data = (const unsigned char*) in->data;
+        in->pos = in_digits(data + in->pos, data + in->end, base, &value) - data;
+    } while(in->pos == in->end && in_fill(in));
+
+    return negative ? -value : value;
+}
+
+/*
+ * Takes as much buffered input as holds only whole numbers, reading more
+ * first if the buffer is not full: the text given ends at whitespace or at
+ * the end of input, so that it can be parsed with parse_int without the
+ * reader. The text stays valid until the next read. Gives 0 at the end of
+ * input.
+ */
+size_t in_take_block(struct OML_INPUT* in, const char** text) {
+    // keep a partial number, then fill the rest of the buffer
+    if(in->pos) {
+        memmove(in->data, in->data + in->pos, in->end - in->pos);
+        in->end -= in->pos;
+        in->pos = 0;
+    }
+    while(in->end < IN_BUFFER_SIZE && in_read(in)) {
+        continue;
+    }
+
+    size_t cut = in->end;
+    if(!in->eof) {
+        while(cut > 0 && !in_is_space(in->data[cut - 1])) {
+            cut--;
+        }
+        // one number fills the buffer; it can only wrap anyway
+        if(cut == 0) {
+            cut = in->end;
+        }
+    }
+    *text = in->data;
+    in->pos = cut;
+    return cut;
+}
+
+/*
+ * Parses the next integer in [*pos, end) as in_int does, skipping any
+ * whitespace, and moves *pos after it. Gives false, leaving *pos at the
+ * first character left, if no number is next.
+ */
+bool parse_int(const char** pos, const char* end, int64_t base, int64_t* res) {
+    const unsigned char* at = (const unsigned char*) *pos;
+    const unsigned char* stop = (const unsigned char*) end;
+    while(at < stop && in_is_space(*at)) {
+        at++;
+    }
+    *pos = (const char*) at;
+    if(at == stop || (*at != '-' && *at != '+' && IN_DIGITS[*at] >= base)) {
+        return false;
+    }
+    bool negative = *at == '-';
+    if(*at == '-' || *at == '+') {
+        at++;
+    }
+    uint64_t value = 0;
+    *pos = (const char*) in_digits(at, stop, base, &value);
+    *res = negative ? -value : value;
+    return true;
+}
+
+// reads a decimal number after any whitespace, such as -1.5 or 2e10
+double in_double(struct OML_INPUT* in) {
+    char temp[IN_DOUBLE_SIZE];
+    size_t size = 0;
+    int c;
+    in_skip_space(in);
+    while(size < IN_DOUBLE_SIZE - 1 && (c = in_peek(in)) != EOF
+            && (isdigit(c) || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E')) {
+        temp[size++] = c;
+        in->pos++;
+    }
+    temp[size] = '\0';
+    return strtod(temp, NULL);
+}
@@ -0,0 +1,851 @@
+// native compilation of hot loops and bodies for x86-64
+
+#include <stdio.h>      /* for fprintf */
+#include <stdlib.h>     /* for malloc, calloc, free */
+#include <string.h>     /* for memcpy */
+
+#include "OML.h"
+
+// back-edges a loop takes before it is compiled
+#define JIT_THRESHOLD   (64)
+// guard failures a specialized loop takes before it is recompiled
+#define JIT_MAX_BAILS   (64)
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>   /* for mmap, mprotect */
+
+/*
+ * A compiled loop is entered at its `)' with a truthy top of stack, and runs
+ * iterations of the body until the top of stack is falsy. Before every
+ * iteration it checks that the body cannot pop past the end of the stack or
+ * push past its capacity; if either could happen it returns 0 between two
+ * iterations and the interpreter carries on with the body. It returns 1
+ * once the loop has ended.
+ *
+ * Two shapes of loop are compiled:
+ *  - whole: the stack holds few enough cells to live in registers, and the
+ *    body leaves its depth unchanged. The stack is loaded once, and commands
+ *    touching the bottom of the stack or its length are register renames.
+ *  - window: the body touches only the top cells of the stack. These are
+ *    loaded into registers, the body runs on them, and the result is stored
+ *    back, every iteration.
+ * In both, the body runs on a stack of registers tracked at compile time, so
+ * that it executes no pushes or pops of its own.
+ */
+typedef int (*OML_JIT_FN)(int64_t* data, size_t* size, size_t capacity);
+
+enum { JIT_COLD, JIT_COMPILED, JIT_FAILED };
+
+typedef struct OML_JIT_LOOP {
+    int state;
+    bool whole;             // compiled as a whole loop
+    size_t count, bails;
+    size_t code_size;
+    OML_JIT_FN fn;
+} OML_JIT_LOOP;
+
+struct OML_JIT {
+    OML_JIT_LOOP* loops;    // indexed by the pc of the `)', or of the `e(' or `e{'
+    size_t size;
+};
+
+// machine registers
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// registers holding stack cells; rdi, rsi and rbp hold the arguments,
+// rax and rdx serve division and r11 is scratch
+static const int JIT_REGS[] = { RCX, R8, R9, R10, RBX, R12, R13, R14, R15 };
+#define JIT_REG_COUNT   (sizeof JIT_REGS / sizeof *JIT_REGS)
+
+typedef struct JIT_BUF {
+    uint8_t* code;
+    size_t size, capacity;
+    // the compile-time stack: the register holding each cell
+    int cells[JIT_REG_COUNT];
+    size_t depth;
+    // registers popped by the instruction being emitted
+    unsigned pinned;
+    bool whole;
+    bool failed;
+} JIT_BUF;
+
+static void jit_byte(JIT_BUF* buf, uint8_t b) {
+    if(buf->size >= buf->capacity) {
+        buf->capacity *= 2;
+        buf->code = realloc(buf->code, buf->capacity);
+    }
+    buf->code[buf->size++] = b;
+}
+
+static void jit_u32(JIT_BUF* buf, uint32_t v) {
+    for(int i = 0; i < 4; i++) {
+        jit_byte(buf, v >> (8 * i));
+    }
+}
+
+static void jit_u64(JIT_BUF* buf, uint64_t v) {
+    for(int i = 0; i < 8; i++) {
+        jit_byte(buf, v >> (8 * i));
+    }
+}
+
+// REX.W prefix addressing `reg' in ModRM.reg and `rm' in ModRM.rm
+static void jit_rex(JIT_BUF* buf, int reg, int rm) {
+    jit_byte(buf, 0x48 | ((reg >> 3) << 2) | (rm >> 3));
+}
+
+// <op> rm, reg on two 64-bit registers
+static void jit_rr(JIT_BUF* buf, uint8_t op, int reg, int rm) {
+    jit_rex(buf, reg, rm);
+    jit_byte(buf, op);
+    jit_byte(buf, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// <op> reg, [base + disp] on a 64-bit register
+static void jit_mem(JIT_BUF* buf, uint8_t op, int reg, int base, int32_t disp) {
+    jit_rex(buf, reg, base);
+    jit_byte(buf, op);
+    jit_byte(buf, 0x80 | ((reg & 7) << 3) | (base & 7));
+    jit_u32(buf, disp);
+}
+
+static void jit_mov(JIT_BUF* buf, int dst, int src) {
+    if(dst != src) {
+        jit_rr(buf, 0x89, src, dst);
+    }
+}
+
+static void jit_mov_imm(JIT_BUF* buf, int dst, int64_t value) {
+    if(value == 0) {
+        jit_rr(buf, 0x31, dst, dst);
+        return;
+    }
+    jit_byte(buf, 0x48 | (dst >> 3));
+    jit_byte(buf, 0xB8 | (dst & 7));
+    jit_u64(buf, value);
+}
+
+// imul dst, src
+static void jit_imul(JIT_BUF* buf, int dst, int src) {
+    jit_rex(buf, dst, src);
+    jit_byte(buf, 0x0F);
+    jit_byte(buf, 0xAF);
+    jit_byte(buf, 0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+// F7 /ext on a 64-bit register: neg, not, idiv
+static void jit_unary(JIT_BUF* buf, int ext, int reg) {
+    jit_rex(buf, 0, reg);
+    jit_byte(buf, 0xF7);
+    jit_byte(buf, 0xC0 | (ext << 3) | (reg & 7));
+}
+
+// dst = <condition code> ? 1 : 0, by way of r11b
+static void jit_setcc(JIT_BUF* buf, uint8_t cc, int dst) {
+    jit_byte(buf, 0x41);
+    jit_byte(buf, 0x0F);
+    jit_byte(buf, 0x90 | cc);
+    jit_byte(buf, 0xC3);
+    jit_rex(buf, dst, R11);
+    jit_byte(buf, 0x0F);
+    jit_byte(buf, 0xB6);
+    jit_byte(buf, 0xC0 | ((dst & 7) << 3) | (R11 & 7));
+}
+
+// emits a jcc or jmp with a 32-bit displacement, returning where to patch it
+static size_t jit_jump(JIT_BUF* buf, int cc) {
+    if(cc < 0) {
+        jit_byte(buf, 0xE9);
+    }
+    else {
+        jit_byte(buf, 0x0F);
+        jit_byte(buf, 0x80 | cc);
+    }
+    jit_u32(buf, 0);
+    return buf->size;
+}
+
+static void jit_patch(JIT_BUF* buf, size_t from, size_t to) {
+    int32_t rel = (int64_t) to - (int64_t) from;
+    memcpy(buf->code + from - 4, &rel, 4);
+}
+
+// condition codes
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6,
+       CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+static int jit_alloc(JIT_BUF* buf) {
+    for(size_t r = 0; r < JIT_REG_COUNT; r++) {
+        bool used = buf->pinned & (1u << JIT_REGS[r]);
+        for(size_t j = 0; j < buf->depth; j++) {
+            used |= buf->cells[j] == JIT_REGS[r];
+        }
+        if(!used) {
+            return JIT_REGS[r];
+        }
+    }
+    buf->failed = true;
+    return R11;
+}
+
+static void jit_push(JIT_BUF* buf, int reg) {
+    if(buf->depth >= JIT_REG_COUNT) {
+        buf->failed = true;
+        return;
+    }
+    buf->cells[buf->depth++] = reg;
+}
+
+// pops the top cell; a whole loop knows its stack is empty and reads zero
+static int jit_pop(JIT_BUF* buf) {
+    if(buf->depth == 0) {
+        if(!buf->whole) {
+            buf->failed = true;
+            return R11;
+        }
+        int reg = jit_alloc(buf);
+        jit_mov_imm(buf, reg, 0);
+        buf->pinned |= 1u << reg;
+        return reg;
+    }
+    int reg = buf->cells[--buf->depth];
+    buf->pinned |= 1u << reg;
+    return reg;
+}
+
+// pushes a fresh copy of `reg'
+static void jit_copy(JIT_BUF* buf, int reg) {
+    int dst = jit_alloc(buf);
+    jit_mov(buf, dst, reg);
+    jit_push(buf, dst);
+}
+
+// emits one instruction of the body, or fails
+static void jit_instr(JIT_BUF* buf, OML* inst, OML_INSTR* instr) {
+    int op = instr->op;
+    buf->pinned = 0;
+    if(op == OP_PUSH) {
+        int reg = jit_alloc(buf);
+        jit_mov_imm(buf, reg, instr->value);
+        jit_push(buf, reg);
+    }
+    else if(op == OP_ADD || op == OP_SUB || op == OP_AND || op == OP_OR || op == OP_XOR) {
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        uint8_t code = op == OP_ADD ? 0x01
+                     : op == OP_SUB ? 0x29
+                     : op == OP_AND ? 0x21
+                     : op == OP_OR  ? 0x09
+                     : 0x31;
+        jit_rr(buf, code, b, a);
+        jit_push(buf, a);
+    }
+    else if(op == OP_MUL) {
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        jit_imul(buf, a, b);
+        jit_push(buf, a);
+    }
+    else if(op == OP_DIV || op == OP_MOD) {
+        // idiv faults on the same operands as the interpreter's / and %
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        jit_mov(buf, RAX, a);
+        jit_byte(buf, 0x48);
+        jit_byte(buf, 0x99);
+        jit_unary(buf, 7, b);
+        jit_mov(buf, a, op == OP_DIV ? RAX : RDX);
+        jit_push(buf, a);
+    }
+    else if(op == OP_ADD_IMM || op == OP_MUL_IMM || op == OP_MOD_IMM) {
+        int a = jit_pop(buf);
+        jit_mov_imm(buf, R11, instr->value);
+        if(op == OP_ADD_IMM) {
+            jit_rr(buf, 0x01, R11, a);
+        }
+        else if(op == OP_MUL_IMM) {
+            jit_imul(buf, a, R11);
+        }
+        else {
+            jit_mov(buf, RAX, a);
+            jit_byte(buf, 0x48);
+            jit_byte(buf, 0x99);
+            jit_unary(buf, 7, R11);
+            jit_mov(buf, a, RDX);
+        }
+        jit_push(buf, a);
+    }
+    else if(op == OP_NEGATE || op == OP_COMPLEMENT) {
+        int a = jit_pop(buf);
+        jit_unary(buf, op == OP_NEGATE ? 3 : 2, a);
+        jit_push(buf, a);
+    }
+    else if(op == OP_NOT) {
+        int a = jit_pop(buf);
+        jit_rr(buf, 0x85, a, a);
+        jit_setcc(buf, CC_E, a);
+        jit_push(buf, a);
+    }
+    else if(op == OP_SQUARE || op == OP_CUBE) {
+        int a = jit_pop(buf);
+        jit_mov(buf, R11, a);
+        jit_imul(buf, a, R11);
+        if(op == OP_CUBE) {
+            jit_imul(buf, a, R11);
+        }
+        jit_push(buf, a);
+    }
+    else if(op == OP_LT || op == OP_EQ || op == OP_GT
+         || op == OP_GE || op == OP_NE || op == OP_LE) {
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        uint8_t cc = op == OP_LT ? CC_L
+                   : op == OP_EQ ? CC_E
+                   : op == OP_GT ? CC_G
+                   : op == OP_GE ? CC_GE
+                   : op == OP_NE ? CC_NE
+                   : CC_LE;
+        jit_rr(buf, 0x39, b, a);
+        jit_setcc(buf, cc, a);
+        jit_push(buf, a);
+    }
+    else if(op == OP_DUP) {
+        int a = jit_pop(buf);
+        jit_push(buf, a);
+        jit_copy(buf, a);
+    }
+    else if(op == OP_TRIPLICATE) {
+        int a = jit_pop(buf);
+        jit_push(buf, a);
+        jit_copy(buf, a);
+        jit_copy(buf, a);
+    }
+    else if(op == OP_DROP) {
+        jit_pop(buf);
+    }
+    else if(op == OP_SWAP) {
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        jit_push(buf, b);
+        jit_push(buf, a);
+    }
+    else if(op == OP_NIP) {
+        int b = jit_pop(buf);
+        jit_pop(buf);
+        jit_push(buf, b);
+    }
+    else if(op == OP_OVER) {
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        jit_push(buf, a);
+        jit_push(buf, b);
+        jit_copy(buf, a);
+    }
+    else if(op == OP_ROT) {
+        int c = jit_pop(buf);
+        int b = jit_pop(buf);
+        int a = jit_pop(buf);
+        jit_push(buf, c);
+        jit_push(buf, a);
+        jit_push(buf, b);
+    }
+    else if(op == OP_LOAD_VAR || op == OP_STORE_VAR) {
+        jit_mov_imm(buf, R11, (intptr_t) &inst->vars[instr->value]);
+        if(op == OP_LOAD_VAR) {
+            int reg = jit_alloc(buf);
+            jit_mem(buf, 0x8B, reg, R11, 0);
+            jit_push(buf, reg);
+        }
+        else {
+            int a = jit_pop(buf);
+            jit_mem(buf, 0x89, a, R11, 0);
+        }
+    }
+    // the bottom and length of the stack are only known in a whole loop
+    else if(op == OP_TOP_TO_BOTTOM && buf->whole) {
+        int a = jit_pop(buf);
+        memmove(buf->cells + 1, buf->cells, buf->depth * sizeof(int));
+        buf->cells[0] = a;
+        buf->depth++;
+    }
+    else if(op == OP_BOTTOM_TO_TOP && buf->whole && buf->depth) {
+        int a = buf->cells[0];
+        memmove(buf->cells, buf->cells + 1, --buf->depth * sizeof(int));
+        jit_push(buf, a);
+    }
+    else if(op == OP_LENGTH && buf->whole) {
+        int reg = jit_alloc(buf);
+        jit_mov_imm(buf, reg, buf->depth);
+        jit_push(buf, reg);
+    }
+    else {
+        buf->failed = true;
+    }
+}
+
+// moves the cells into JIT_REGS[0..depth) without clobbering any of them
+static void jit_settle(JIT_BUF* buf) {
+    bool moved = true;
+    while(moved) {
+        moved = false;
+        bool pending = false;
+        for(size_t j = 0; j < buf->depth; j++) {
+            int want = JIT_REGS[j];
+            if(buf->cells[j] == want) {
+                continue;
+            }
+            pending = true;
+            bool busy = false;
+            for(size_t k = 0; k < buf->depth; k++) {
+                busy |= buf->cells[k] == want;
+            }
+            if(!busy) {
+                jit_mov(buf, want, buf->cells[j]);
+                buf->cells[j] = want;
+                moved = true;
+            }
+        }
+        // only cycles remain; break one through the scratch register
+        if(pending && !moved) {
+            for(size_t j = 0; j < buf->depth; j++) {
+                if(buf->cells[j] != JIT_REGS[j]) {
+                    jit_mov(buf, R11, buf->cells[j]);
+                    buf->cells[j] = R11;
+                    moved = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// net effect, lowest and highest depth of the body relative to its entry
+static bool jit_stack_effect(OML_INSTR* body, size_t count, int64_t* net, int64_t* low, int64_t* high) {
+    // cells popped and pushed by each supported opcode
+    static const signed char POPS[OP_COUNT] = {
+        [OP_ADD] = 2, [OP_SUB] = 2, [OP_MUL] = 2, [OP_DIV] = 2, [OP_MOD] = 2,
+        [OP_AND] = 2, [OP_OR] = 2, [OP_XOR] = 2, [OP_LT] = 2, [OP_EQ] = 2,
+        [OP_GT] = 2, [OP_GE] = 2, [OP_NE] = 2, [OP_LE] = 2, [OP_SWAP] = 2,
+        [OP_NIP] = 2, [OP_OVER] = 2, [OP_ROT] = 3, [OP_ADD_IMM] = 1,
+        [OP_MUL_IMM] = 1, [OP_MOD_IMM] = 1, [OP_NEGATE] = 1, [OP_COMPLEMENT] = 1,
+        [OP_NOT] = 1, [OP_SQUARE] = 1, [OP_CUBE] = 1, [OP_DUP] = 1,
+        [OP_TRIPLICATE] = 1, [OP_DROP] = 1, [OP_STORE_VAR] = 1,
+        [OP_TOP_TO_BOTTOM] = 1, [OP_BOTTOM_TO_TOP] = 1,
+    };
+    static const signed char PUSHES[OP_COUNT] = {
+        [OP_PUSH] = 1, [OP_ADD] = 1, [OP_SUB] = 1, [OP_MUL] = 1, [OP_DIV] = 1,
+        [OP_MOD] = 1, [OP_AND] = 1, [OP_OR] = 1, [OP_XOR] = 1, [OP_LT] = 1,
+        [OP_EQ] = 1, [OP_GT] = 1, [OP_GE] = 1, [OP_NE] = 1, [OP_LE] = 1,
+        [OP_SWAP] = 2, [OP_NIP] = 1, [OP_OVER] = 3, [OP_ROT] = 3,
+        [OP_ADD_IMM] = 1, [OP_MUL_IMM] = 1, [OP_MOD_IMM] = 1, [OP_NEGATE] = 1,
+        [OP_COMPLEMENT] = 1, [OP_NOT] = 1, [OP_SQUARE] = 1, [OP_CUBE] = 1,
+        [OP_DUP] = 2, [OP_TRIPLICATE] = 3, [OP_LOAD_VAR] = 1,
+        [OP_TOP_TO_BOTTOM] = 1, [OP_BOTTOM_TO_TOP] = 1, [OP_LENGTH] = 1,
+    };
+    int64_t depth = 0;
+    *low = *high = 0;
+    for(size_t i = 0; i < count; i++) {
+        int op = body[i].op;
+        if(!POPS[op] && !PUSHES[op]) {
+            return false;
+        }
+        depth -= POPS[op];
+        if(depth < *low) {
+            *low = depth;
+        }
+        depth += PUSHES[op];
+        if(depth > *high) {
+            *high = depth;
+        }
+    }
+    *net = depth;
+    return true;
+}
+
+// saves the callee-saved registers the cells live in
+static void jit_prologue(JIT_BUF* buf) {
+    jit_byte(buf, 0x53);                            // push rbx
+    jit_byte(buf, 0x55);                            // push rbp
+    for(int r = R12; r <= R15; r++) {
+        jit_byte(buf, 0x41);                        // push r12..r15
+        jit_byte(buf, 0x50 | (r & 7));
+    }
+}
+
+static void jit_epilogue(JIT_BUF* buf) {
+    for(int r = R15; r >= R12; r--) {
+        jit_byte(buf, 0x41);
+        jit_byte(buf, 0x58 | (r & 7));
+    }
+    jit_byte(buf, 0x5D);
+    jit_byte(buf, 0x5B);
+    jit_byte(buf, 0xC3);
+}
+
+// copies the code of `buf' into executable memory as the code of `loop',
+// freeing the buffer either way
+static bool jit_install(OML_JIT_LOOP* loop, JIT_BUF* buf) {
+    void* mem = mmap(NULL, buf->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) {
+        free(buf->code);
+        return false;
+    }
+    memcpy(mem, buf->code, buf->size);
+    free(buf->code);
+    if(mprotect(mem, buf->size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, buf->size);
+        return false;
+    }
+
+    if(loop->fn) {
+        munmap((void*) loop->fn, loop->code_size);
+    }
+    loop->fn = (OML_JIT_FN) mem;
+    loop->code_size = buf->size;
+    return true;
+}
+
+// compiles the loop whose body is `body', given the current stack size
+static bool jit_compile(OML* inst, OML_JIT_LOOP* loop, OML_INSTR* body, size_t count, size_t size) {
+    int64_t net, low, high;
+    if(!jit_stack_effect(body, count, &net, &low, &high)) {
+        return false;
+    }
+    // once a whole loop has missed its depth, compile a window instead
+    bool whole = loop->bails == 0 && net == 0 && size >= 1
+              && size + high <= (int64_t) JIT_REG_COUNT;
+    // a window must hold the cells the body pops and the new top of stack
+    int64_t window = -low;
+    if(window < 1 - net) {
+        window = 1 - net;
+    }
+    if(!whole && window + high > (int64_t) JIT_REG_COUNT) {
+        return false;
+    }
+
+    JIT_BUF buf = { malloc(256), 0, 256, { 0 }, 0, 0, whole, false };
+    jit_prologue(&buf);
+    jit_mov(&buf, RBP, RDX);
+
+    size_t bail_from[2], bail_count = 0;
+    size_t top;
+
+    if(whole) {
+        // guard: the stack is exactly as deep as it was when compiled
+        jit_mem(&buf, 0x8B, RAX, RSI, 0);
+        jit_byte(&buf, 0x48);                       // cmp rax, imm32
+        jit_byte(&buf, 0x3D);
+        jit_u32(&buf, size);
+        bail_from[bail_count++] = jit_jump(&buf, CC_NE);
+        for(size_t j = 0; j < size; j++) {
+            jit_mem(&buf, 0x8B, JIT_REGS[j], RDI, 8 * j);
+        }
+        buf.depth = size;
+        for(size_t j = 0; j < size; j++) {
+            buf.cells[j] = JIT_REGS[j];
+        }
+        top = buf.size;
+        for(size_t i = 0; i < count && !buf.failed; i++) {
+            jit_instr(&buf, inst, &body[i]);
+        }
+        jit_settle(&buf);
+        jit_rr(&buf, 0x85, JIT_REGS[size - 1], JIT_REGS[size - 1]);
+        jit_patch(&buf, jit_jump(&buf, CC_NE), top);
+        for(size_t j = 0; j < size; j++) {
+            jit_mem(&buf, 0x89, JIT_REGS[j], RDI, 8 * j);
+        }
+    }
+    else {
+        top = buf.size;
+        // guard: the body pops no further than the stack, and pushes no
+        // further than its capacity
+        jit_mem(&buf, 0x8B, RAX, RSI, 0);
+        jit_byte(&buf, 0x48);                       // cmp rax, imm32
+        jit_byte(&buf, 0x3D);
+        jit_u32(&buf, window);
+        bail_from[bail_count++] = jit_jump(&buf, CC_B);
+        jit_byte(&buf, 0x4C);                       // lea r11, [rax + high]
+        jit_byte(&buf, 0x8D);
+        jit_byte(&buf, 0x98);
+        jit_u32(&buf, high);
+        jit_rr(&buf, 0x39, RBP, R11);
+        bail_from[bail_count++] = jit_jump(&buf, CC_AE);
+        jit_byte(&buf, 0x4C);                       // lea r11, [rdi + rax*8 - window*8]
+        jit_byte(&buf, 0x8D);
+        jit_byte(&buf, 0x9C);
+        jit_byte(&buf, 0xC7);
+        jit_u32(&buf, -8 * window);
+        for(int64_t j = 0; j < window; j++) {
+            jit_mem(&buf, 0x8B, JIT_REGS[j], R11, 8 * j);
+            buf.cells[j] = JIT_REGS[j];
+        }
+        buf.depth = window;
+        for(size_t i = 0; i < count && !buf.failed; i++) {
+            jit_instr(&buf, inst, &body[i]);
+        }
+        // division may have clobbered rax, so find the window again
+        jit_mem(&buf, 0x8B, RAX, RSI, 0);
+        jit_byte(&buf, 0x4C);
+        jit_byte(&buf, 0x8D);
+        jit_byte(&buf, 0x9C);
+        jit_byte(&buf, 0xC7);
+        jit_u32(&buf, -8 * window);
+        for(size_t j = 0; j < buf.depth; j++) {
+            jit_mem(&buf, 0x89, buf.cells[j], R11, 8 * j);
+        }
+        if(net) {
+            jit_byte(&buf, 0x48);                   // add qword [rsi], net
+            jit_byte(&buf, 0x81);
+            jit_byte(&buf, 0x06);
+            jit_u32(&buf, net);
+        }
+        int tos = buf.depth ? buf.cells[buf.depth - 1] : R11;
+        jit_rr(&buf, 0x85, tos, tos);
+        jit_patch(&buf, jit_jump(&buf, CC_NE), top);
+    }
+
+    // the loop ended
+    jit_byte(&buf, 0xB8);                           // mov eax, 1
+    jit_u32(&buf, 1);
+    size_t done = jit_jump(&buf, -1);
+    for(size_t i = 0; i < bail_count; i++) {
+        jit_patch(&buf, bail_from[i], buf.size);
+    }
+    jit_rr(&buf, 0x31, RAX, RAX);
+    jit_patch(&buf, done, buf.size);
+    jit_epilogue(&buf);
+
+    if(buf.failed || (whole && buf.depth != size)) {
+        free(buf.code);
+        return false;
+    }
+    if(!jit_install(loop, &buf)) {
+        return false;
+    }
+    loop->whole = whole;
+    return true;
+}
+
+/*
+ * Compiles the body of an `e{' (map) or `e(' (reduce) into a loop over the
+ * members, for bodies of straight-line arithmetic. A map runs the body on
+ * each member as a stack of its own, as OML_map does, so it is compiled like
+ * a whole loop of depth 1 and the top it leaves is stored back. A reduce body
+ * must take the top two cells and leave one: it then folds the members from
+ * the top down, the result so far as the upper cell, and leaves the stack
+ * holding only the result. The code always returns 1.
+ */
+static bool jit_compile_body(OML* inst, OML_JIT_LOOP* loop, OML_INSTR* body, size_t count, bool reduce) {
+    int64_t net, low, high;
+    if(!jit_stack_effect(body, count, &net, &low, &high)
+            || (reduce && (net != -1 || low < -2))) {
+        return false;
+    }
+
+    JIT_BUF buf = { malloc(256), 0, 256, { 0 }, 0, 0, !reduce, false };
+    jit_prologue(&buf);
+    jit_mem(&buf, 0x8B, RBP, RSI, 0);               // mov rbp, [rsi]
+    size_t top, done;
+
+    if(!reduce) {
+        jit_byte(&buf, 0x48);                       // lea rbp, [rdi + rbp*8]
+        jit_byte(&buf, 0x8D);
+        jit_byte(&buf, 0x2C);
+        jit_byte(&buf, 0xEF);
+        top = buf.size;
+        jit_rr(&buf, 0x39, RBP, RDI);               // cmp rdi, rbp
+        done = jit_jump(&buf, CC_AE);
+        jit_mem(&buf, 0x8B, JIT_REGS[0], RDI, 0);
+        buf.cells[0] = JIT_REGS[0];
+        buf.depth = 1;
+        for(size_t i = 0; i < count && !buf.failed; i++) {
+            jit_instr(&buf, inst, &body[i]);
+        }
+        // an emptied stack leaves 0 on top
+        int tos = R11;
+        if(buf.depth) {
+            tos = buf.cells[buf.depth - 1];
+        }
+        else {
+            jit_mov_imm(&buf, R11, 0);
+        }
+        jit_mem(&buf, 0x89, tos, RDI, 0);
+        jit_byte(&buf, 0x48);                       // add rdi, 8
+        jit_byte(&buf, 0x83);
+        jit_byte(&buf, 0xC7);
+        jit_byte(&buf, 0x08);
+    }
+    else {
+        jit_byte(&buf, 0x48);                       // lea rbp, [rdi + rbp*8 - 8]
+        jit_byte(&buf, 0x8D);
+        jit_byte(&buf, 0x6C);
+        jit_byte(&buf, 0xEF);
+        jit_byte(&buf, 0xF8);
+        jit_mem(&buf, 0x8B, JIT_REGS[0], RBP, 0);
+        top = buf.size;
+        jit_rr(&buf, 0x39, RDI, RBP);               // cmp rbp, rdi
+        done = jit_jump(&buf, CC_BE);
+        jit_byte(&buf, 0x48);                       // sub rbp, 8
+        jit_byte(&buf, 0x83);
+        jit_byte(&buf, 0xED);
+        jit_byte(&buf, 0x08);
+        jit_mem(&buf, 0x8B, JIT_REGS[1], RBP, 0);
+        buf.cells[0] = JIT_REGS[1];
+        buf.cells[1] = JIT_REGS[0];
+        buf.depth = 2;
+        for(size_t i = 0; i < count && !buf.failed; i++) {
+            jit_instr(&buf, inst, &body[i]);
+        }
+        buf.failed |= buf.depth != 1;
+        jit_settle(&buf);
+    }
+    jit_patch(&buf, jit_jump(&buf, -1), top);
+
+    jit_patch(&buf, done, buf.size);
+    if(reduce) {
+        jit_mem(&buf, 0x89, JIT_REGS[0], RDI, 0);
+        jit_byte(&buf, 0x48);                       // mov qword [rsi], 1
+        jit_byte(&buf, 0xC7);
+        jit_byte(&buf, 0x06);
+        jit_u32(&buf, 1);
+    }
+    jit_byte(&buf, 0xB8);                           // mov eax, 1
+    jit_u32(&buf, 1);
+    jit_epilogue(&buf);
+
+    if(buf.failed) {
+        free(buf.code);
+        return false;
+    }
+    return jit_install(loop, &buf);
+}
+
+struct OML_JIT* OML_jit_init(OML_PROGRAM* prog) {
+    struct OML_JIT* jit = malloc(sizeof(struct OML_JIT));
+    jit->loops = calloc(prog->size + 1, sizeof(OML_JIT_LOOP));
+    jit->size = prog->size;
+    return jit;
+}
+
+void OML_jit_destroy(struct OML_JIT* jit) {
+    if(!jit) {
+        return;
+    }
+    for(size_t i = 0; i < jit->size; i++) {
+        if(jit->loops[i].fn) {
+            munmap((void*) jit->loops[i].fn, jit->loops[i].code_size);
+        }
+    }
+    free(jit->loops);
+    free(jit);
+}
+
+int OML_jit_loop(OML* inst, size_t pc) {
+    OML_JIT_LOOP* loop = &inst->jit->loops[pc];
+    OML_INSTR* instr = &inst->prog.instrs[pc];
+    STACK* stk = &inst->stk;
+
+    if(loop->state == JIT_FAILED || instr->target > pc) {
+        return JIT_INTERPRET;
+    }
+    if(loop->state == JIT_COLD) {
+        if(++loop->count < JIT_THRESHOLD) {
+            return JIT_INTERPRET;
+        }
+        size_t start = instr->target;
+        bool ok = jit_compile(inst, loop, inst->prog.instrs + start, pc - start, stk->size);
+        loop->state = ok ? JIT_COMPILED : JIT_FAILED;
+        if(!ok) {
+            return JIT_INTERPRET;
+        }
+    }
+
+    // compiled code addresses the members as a flat array, with the cells
+    // of any enclosing frames below it
+    if(stk->head != stk->base && !stack_linearize(stk)) {
+        return JIT_INTERPRET;
+    }
+    // compiled code pushes without counting towards the peak; a loop's depth
+    // changes by the same amount each iteration, so its ends bound it closely
+    int done = loop->fn(stk->data + stk->base, &stk->size, stk->capacity - stk->base);
+    STACK_NOTE_PEAK(stk);
+    if(done) {
+        return JIT_LOOP_DONE;
+    }
+    // a whole loop keeps missing its depth; fall back to a window
+    if(loop->whole && ++loop->bails >= JIT_MAX_BAILS) {
+        size_t start = instr->target;
+        if(!jit_compile(inst, loop, inst->prog.instrs + start, pc - start, stk->size)) {
+            loop->state = JIT_FAILED;
+        }
+    }
+    return JIT_INTERPRET;
+}
+
+bool OML_jit_body(OML* inst, size_t pc) {
+    OML_JIT_LOOP* loop = &inst->jit->loops[pc];
+    OML_INSTR* instr = &inst->prog.instrs[pc];
+    STACK* stk = &inst->stk;
+    bool reduce = instr->op == OP_REDUCE;
+
+    // a reduce runs its body once on an empty stack
+    if(loop->state == JIT_FAILED || (reduce && stk->size == 0)) {
+        return false;
+    }
+    if(loop->state == JIT_COLD) {
+        // counted in members the body has run on
+        loop->count += stk->size;
+        if(loop->count < JIT_THRESHOLD) {
+            return false;
+        }
+        bool ok = jit_compile_body(inst, loop, instr + 1, instr->target - pc - 1, reduce);
+        loop->state = ok ? JIT_COMPILED : JIT_FAILED;
+        if(!ok) {
+            return false;
+        }
+    }
+
+    if(stk->head != stk->base && !stack_linearize(stk)) {
+        return false;
+    }
+    loop->fn(stk->data + stk->base, &stk->size, stk->capacity - stk->base);
+    STACK_NOTE_PEAK(stk);
+    return true;
+}
+
+bool OML_jit_supported(void) {
+    return true;
+}
+
+#else
+
+struct OML_JIT* OML_jit_init(OML_PROGRAM* prog) {
+    (void) prog;
+    return NULL;
+}
+
+void OML_jit_destroy(struct OML_JIT* jit) {
+    (void) jit;
+}
+
+int OML_jit_loop(OML* inst, size_t pc) {
+    (void) inst;
+    (void) pc;
+    return JIT_INTERPRET;
+}
+
+bool OML_jit_body(OML* inst, size_t pc) {
+    (void) inst;
+    (void) pc;
+    return false;
+}
+
+bool OML_jit_supported(void) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,239 @@
+// the command line interpreter, built on the library in OML.c
+
+#include <ctype.h>      /* for isdigit */
+#include <signal.h>     /* for signal, raise, SIGFPE, SIGSEGV */
+#include <stdio.h>      /* for fprintf, fopen, fread */
+#include <stdlib.h>     /* for malloc, free, strtol, strtoull */
+#include <string.h>     /* for strlen, strcmp */
+#include <unistd.h>     /* for sysconf */
+
+#include "OML.h"
+
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+
+static char* read_file(char* name, size_t* out_size) {
+    FILE* file = fopen(name, "r");
+    if(!file) {
+        fprintf(stderr, "Error: no such file %s\n", name);
+        return NULL;
+    }
+    size_t length;
+    char* contents;
+    *out_size = 0;
+
+    if(fseeko(file, 0, SEEK_END) != 0) {
+        return NULL;
+    }
+
+    length = ftello(file);
+
+    if(fseeko(file, 0, SEEK_SET) != 0) {
+        return NULL;
+    }
+
+    contents = malloc(length * sizeof(char));
+    fread(contents, sizeof(char), length, file);
+
+    fclose(file);
+
+    *out_size = length;
+
+    return contents;
+}
+
+// the instance being run, whose output is flushed if the program crashes
+static OML* cli_inst = NULL;
+
+static void cli_crash(int sig) {
+    if(cli_inst) {
+        OML_flush(cli_inst);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void show_help(char* file_name) {
+    eprintf("[[ OML - Ordinal Manipulation Language ]]\n");
+    eprintf(COLOR_HEADER("== Usage ==\n"));
+    eprintf(COLOR_CODE("%s [args] <code>\n"), file_name);
+    eprintf(COLOR_HEADER("== Arguments ==\n"));
+    eprintf("  -?   show this help page\n");
+    eprintf("  -b   treat the input base as binary initially\n");
+    eprintf("  -f   read program from file `<code>' instead\n");
+    eprintf("  -h   treat the input base as hexadecimal initially\n");
+    eprintf("  -j N run pure `e{' maps and -n records on N threads (0: one per CPU)\n");
+    eprintf("  -J   compile hot loops to native code (x86-64 Linux)\n");
+    eprintf("  -m   report the peak memory held by the stacks on exit\n");
+    eprintf("  -n   execute the program over the numbers of stdin\n");
+    eprintf("  -p   report the time spent on each command on exit, as a heat map\n");
+    eprintf("  -P F write that report to file F as JSON\n");
+    eprintf("  -s N seed the random numbers with N, so that runs repeat\n");
+    eprintf("  -u   run the program without peephole optimizations\n");
+    eprintf("  -x   promote numbers that overflow 63 bits to big numbers\n");
+    eprintf("  --stats  report the resizes and peak size of every stack on exit\n");
+    eprintf(COLOR_HEADER("== About ==\n"));
+    eprintf("OML is a language similar to dc with its primary data type being the integer.\n");
+    eprintf("Like in dc, all numbers are stored on the `stack', to which integers are added\n");
+    eprintf("or removed. OML is a tool that can perform arithmetic calculations and generic\n");
+    eprintf("algorithms, with some effort. While esoteric in nature, it still can provide\n");
+    eprintf("succinct utilities.\n");
+    eprintf(COLOR_HEADER("== Examples ==\n"));
+    eprintf("Convert hexadecimal to decimal: "COLOR_CODE("%s -hn")"\n", file_name);
+    eprintf("Convert hexadecimal to binary: "COLOR_CODE("%s -hn 2Q")"\n", file_name);
+    eprintf("N-th fibonacci: "COLOR_CODE("%s '01h(Z:@+z1-)\\d'")"\n", file_name);
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        eprintf("Error: insufficient arguments passed to %s.", argv[0]);
+        return 1;
+    }
+    char* prog = "";
+    size_t prog_len;
+    bool from_file = false, over_numbers = false, optimize = true, jit = false;
+    bool report_memory = false, bigint = false, profile = false, report_stats = false;
+    char* profile_file = NULL;
+    long threads = 1;
+    bool seeded = false;
+    unsigned long long seed = 0;
+    int input_base = 10, output_base = 10;
+    for(int i = 1; i < argc; i++) {
+        char* arg = argv[i];
+        if(strcmp(arg, "--stats") == 0) {
+            report_stats = true;
+        }
+        else if(arg[0] == '-') {
+            arg++;
+            while(*arg) {
+                if(*arg == 'f')
+                    from_file = true;
+                else if(*arg == 'n')
+                    over_numbers = true;
+                else if(*arg == 'o')
+                    input_base = 8;
+                else if(*arg == 'h')
+                    input_base = 16;
+                else if(*arg == 'b')
+                    input_base = 2;
+                else if(*arg == 'O')
+                    output_base = 8;
+                else if(*arg == 'H')
+                    output_base = 16;
+                else if(*arg == 'B')
+                    output_base = 2;
+                else if(*arg == 'u')
+                    optimize = false;
+                else if(*arg == 'J')
+                    jit = true;
+                else if(*arg == 'm')
+                    report_memory = true;
+                else if(*arg == 'x')
+                    bigint = true;
+                else if(*arg == 'p')
+                    profile = true;
+                else if(*arg == 'P') {
+                    // -PFILE or -P FILE
+                    profile_file = arg + 1;
+                    if(!*profile_file && i + 1 < argc) {
+                        profile_file = argv[++i];
+                    }
+                    break;
+                }
+                else if(*arg == 'j') {
+                    // -jN or -j N; a bare -j means one thread per CPU
+                    char* count = arg + 1;
+                    if(!*count && i + 1 < argc && isdigit(argv[i + 1][0])) {
+                        count = argv[++i];
+                    }
+                    threads = strtol(count, NULL, 10);
+                    if(threads <= 0) {
+                        threads = sysconf(_SC_NPROCESSORS_ONLN);
+                    }
+                    break;
+                }
+                else if(*arg == 's') {
+                    // -sN or -s N
+                    char* value = arg + 1;
+                    if(!*value && i + 1 < argc) {
+                        value = argv[++i];
+                    }
+                    seed = strtoull(value, NULL, 10);
+                    seeded = true;
+                    break;
+                }
+                else if(*arg == '?') {
+                    show_help(argv[0]);
+                    return -1;
+                }
+                arg++;
+            }
+        }
+        else {
+            prog = arg;
+        }
+    }
+    if(from_file) {
+        prog = read_file(prog, &prog_len);
+    }
+    else {
+        prog_len = strlen(prog);
+    }
+    OML* res = OML_create(prog, prog_len);
+    if(from_file) {
+        free(prog);
+    }
+    if(seeded) {
+        OML_seed(res, seed);
+    }
+    res->input_base = input_base;
+    res->output_base = output_base;
+    if(bigint) {
+        OML_set_bigint(res);
+    }
+    if(optimize) {
+        OML_optimize(&res->prog);
+    }
+    if(jit) {
+        if(OML_jit_supported()) {
+            res->jit = OML_jit_init(&res->prog);
+        }
+        else {
+            eprintf("Warning: no JIT for this platform, interpreting instead\n");
+        }
+    }
+    if(threads > 1) {
+        res->pool = OML_pool_init(threads);
+    }
+    if(profile || profile_file) {
+        res->profile = OML_profile_init(&res->prog);
+    }
+    cli_inst = res;
+    signal(SIGFPE, cli_crash);
+    signal(SIGSEGV, cli_crash);
+    if(over_numbers) {
+        OML_run_numbers(res);
+    }
+    else {
+        OML_run(res);
+        if(!res->exited) {
+            OML_display(res, res->stk);
+        }
+    }
+    if(report_memory && !res->exited) {
+        out_printf(res->out, 2, "peak arena usage: %lu bytes, %lu in registers\n",
+            (unsigned long) arena_peak(res->arena), (unsigned long) arena_peak(res->reg_arena));
+    }
+    if(report_stats) {
+        OML_report_stats(res, 2);
+    }
+    if(profile) {
+        OML_profile_report(res, 2);
+    }
+    if(profile_file && !OML_profile_save(res, profile_file)) {
+        eprintf("Error: could not write the profile to %s\n", profile_file);
+    }
+    int code = res->exited ? res->exit_code : 0;
+    cli_inst = NULL;
+    OML_destroy(res);
+    return code;
+}
@@ -11,7 +11,7 @@
     #include <sys/time.h>
     #define M_OS_SANE
 #endif
-int ms_delay(void) {
+static int ms_delay(void) {
     uint64_t res;
     #ifdef M_OS_WINDOWS
         SYSTEMTIME time;
@@ -0,0 +1,189 @@
+// buffered output shared by every command that writes to a file descriptor
+
+#include <errno.h>      /* for errno, EINTR */
+#include <stdarg.h>     /* for va_list, va_start, va_end */
+#include <stdio.h>      /* for vsnprintf */
+#include <stdlib.h>     /* for malloc, calloc, free */
+#include <sys/stat.h>   /* for fstat */
+#include <unistd.h>     /* for write */
+
+#include "OML.h"
+
+// descriptors below this are buffered; others are written through
+#define OUT_MAX_FD      (16)
+#define OUT_BUFFER_SIZE (64 * 1024)
+
+/*
+ * Every instance has its own output, and within it every descriptor gets its
+ * own buffer, flushed when it fills, before stdin is read and when the
+ * instance is destroyed. Descriptors open on the same file, such as stdout
+ * and stderr on one terminal, must still see their output in program order;
+ * so when output moves to another descriptor, any pending output for the
+ * same file is flushed first. Output given to a sink rather than written to
+ * the descriptors counts as all going to one file.
+ */
+typedef struct OUT_BUFFER {
+    char* data;
+    size_t used;
+    bool known;         /* whether dev and ino have been looked up */
+    dev_t dev;
+    ino_t ino;
+} OUT_BUFFER;
+
+typedef struct OML_OUTPUT {
+    OUT_BUFFER buffers[OUT_MAX_FD];
+    int last;           /* the descriptor written to last */
+    OML_SINK sink;      /* where flushed output goes, or NULL for write() */
+    void* sink_data;
+} OML_OUTPUT;
+
+struct OML_OUTPUT* out_init(void) {
+    OML_OUTPUT* out = calloc(1, sizeof(OML_OUTPUT));
+    out->last = -1;
+    return out;
+}
+
+static void out_raw(OML_OUTPUT* out, int fd, const char* data, size_t size) {
+    if(out->sink) {
+        out->sink(out->sink_data, fd, data, size);
+        return;
+    }
+    while(size) {
+        ssize_t n = write(fd, data, size);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void out_flush(struct OML_OUTPUT* out, int fd) {
+    if(fd < 0 || fd >= OUT_MAX_FD || out->buffers[fd].used == 0) {
+        return;
+    }
+    out_raw(out, fd, out->buffers[fd].data, out->buffers[fd].used);
+    out->buffers[fd].used = 0;
+}
+
+void out_flush_all(struct OML_OUTPUT* out) {
+    for(int fd = 0; fd < OUT_MAX_FD; fd++) {
+        out_flush(out, fd);
+    }
+}
+
+// hands all later output to `sink' instead of writing it to the descriptors
+void out_set_sink(struct OML_OUTPUT* out, OML_SINK sink, void* data) {
+    out_flush_all(out);
+    out->sink = sink;
+    out->sink_data = data;
+    for(int fd = 0; fd < OUT_MAX_FD; fd++) {
+        out->buffers[fd].known = false;
+    }
+}
+
+void out_destroy(struct OML_OUTPUT* out) {
+    if(out == NULL) {
+        return;
+    }
+    out_flush_all(out);
+    for(int fd = 0; fd < OUT_MAX_FD; fd++) {
+        free(out->buffers[fd].data);
+    }
+    free(out);
+}
+
+static void out_identify(OML_OUTPUT* out, int fd) {
+    OUT_BUFFER* buf = &out->buffers[fd];
+    struct stat st;
+    buf->known = true;
+    if(out->sink) {
+        buf->dev = 0;
+        buf->ino = 0;
+    }
+    else if(fstat(fd, &st) == 0) {
+        buf->dev = st.st_dev;
+        buf->ino = st.st_ino;
+    }
+    else {
+        // unknown files are assumed to share nothing
+        buf->dev = 0;
+        buf->ino = fd;
+    }
+}
+
+// makes `fd' the descriptor being written to
+static void out_switch(OML_OUTPUT* out, int fd) {
+    if(fd < 0 || fd >= OUT_MAX_FD) {
+        // written through, so nothing may be left pending before it
+        out_flush_all(out);
+        out->last = -1;
+        return;
+    }
+    OUT_BUFFER* buf = &out->buffers[fd];
+    if(buf->data == NULL) {
+        buf->data = malloc(OUT_BUFFER_SIZE);
+    }
+    if(!buf->known) {
+        out_identify(out, fd);
+    }
+    for(int other = 0; other < OUT_MAX_FD; other++) {
+        OUT_BUFFER* o = &out->buffers[other];
+        if(other != fd && o->used && o->dev == buf->dev && o->ino == buf->ino) {
+            out_flush(out, other);
+        }
+    }
+    out->last = fd;
+}
+
+void out_write(struct OML_OUTPUT* out, int fd, const char* data, size_t size) {
+    if(fd != out->last) {
+        out_switch(out, fd);
+    }
+    if(fd < 0 || fd >= OUT_MAX_FD) {
+        out_raw(out, fd, data, size);
+        return;
+    }
+    OUT_BUFFER* buf = &out->buffers[fd];
+    if(buf->used + size > OUT_BUFFER_SIZE) {
+        out_flush(out, fd);
+        if(size > OUT_BUFFER_SIZE) {
+            out_raw(out, fd, data, size);
+            return;
+        }
+    }
+    memcpy(buf->data + buf->used, data, size);
+    buf->used += size;
+}
+
+void out_char(struct OML_OUTPUT* out, int fd, char c) {
+    if(fd == out->last && out->buffers[fd].used < OUT_BUFFER_SIZE) {
+        out->buffers[fd].data[out->buffers[fd].used++] = c;
+        return;
+    }
+    out_write(out, fd, &c, 1);
+}
+
+void out_printf(struct OML_OUTPUT* out, int fd, const char* format, ...) {
+    char temp[128];
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(temp, sizeof(temp), format, args);
+    va_end(args);
+    if(size < 0) {
+        return;
+    }
+    if((size_t) size < sizeof(temp)) {
+        out_write(out, fd, temp, size);
+        return;
+    }
+    char* big = malloc(size + 1);
+    va_start(args, format);
+    vsnprintf(big, size + 1, format, args);
+    va_end(args);
+    out_write(out, fd, big, size);
+    free(big);
+}
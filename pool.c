@@ -0,0 +1,170 @@
+// a pool of worker threads for running independent iterations in parallel
+
+#include <pthread.h>    /* for pthread_create, pthread_join, pthread_mutex_t, pthread_cond_t */
+#include <stdlib.h>     /* for malloc, free */
+
+#include "OML.h"
+
+// chunks each share is split into, so that idle workers have something to steal
+#define POOL_CHUNKS_PER_WORKER  (8)
+
+/*
+ * Iterations [0, count) are dealt out as one contiguous share per worker.
+ * A worker claims chunks from the front of its own share, and once that is
+ * drained it steals chunks from the shares of the others, so that uneven
+ * iterations do not leave workers idle. Claims are a single atomic add, so
+ * owner and thieves never need a lock. The calling thread takes part as
+ * worker 0; the others sleep between jobs.
+ */
+typedef struct OML_POOL_SHARE {
+    size_t next, end;
+    // keep shares on separate cache lines
+    char pad[64 - 2 * sizeof(size_t)];
+} OML_POOL_SHARE;
+
+typedef struct OML_POOL {
+    size_t workers, chunk;
+    pthread_t* threads;
+    OML_POOL_SHARE* shares;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, idle;
+    size_t generation, busy;
+    bool stop;
+    OML_POOL_FN fn;
+    void* arg;
+} OML_POOL;
+
+typedef struct OML_POOL_WORKER {
+    OML_POOL* pool;
+    size_t id;
+} OML_POOL_WORKER;
+
+// claims the next chunk of `share' into [*lo, *hi), if any remain
+static bool pool_claim(OML_POOL* pool, OML_POOL_SHARE* share, size_t* lo, size_t* hi) {
+    if(__atomic_load_n(&share->next, __ATOMIC_RELAXED) >= share->end) {
+        return false;
+    }
+    *lo = __atomic_fetch_add(&share->next, pool->chunk, __ATOMIC_RELAXED);
+    if(*lo >= share->end) {
+        return false;
+    }
+    *hi = *lo + pool->chunk < share->end ? *lo + pool->chunk : share->end;
+    return true;
+}
+
+static void pool_work(OML_POOL* pool, size_t id) {
+    size_t lo, hi;
+    for(size_t i = 0; i < pool->workers; i++) {
+        OML_POOL_SHARE* share = &pool->shares[(id + i) % pool->workers];
+        while(pool_claim(pool, share, &lo, &hi)) {
+            pool->fn(pool->arg, id, lo, hi);
+        }
+    }
+}
+
+static void* pool_thread(void* arg) {
+    OML_POOL_WORKER* self = arg;
+    OML_POOL* pool = self->pool;
+    size_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while(true) {
+        while(!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if(pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_work(pool, self->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->busy == 0) {
+            pthread_cond_signal(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    free(self);
+    return NULL;
+}
+
+// starts a pool of `workers' threads, counting the caller; NULL on failure
+struct OML_POOL* OML_pool_init(size_t workers) {
+    OML_POOL* pool = malloc(sizeof(OML_POOL));
+    pool->workers = workers;
+    pool->chunk = 1;
+    pool->threads = malloc(workers * sizeof(pthread_t));
+    pool->shares = malloc(workers * sizeof(OML_POOL_SHARE));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->stop = false;
+
+    for(size_t i = 1; i < workers; i++) {
+        OML_POOL_WORKER* worker = malloc(sizeof(OML_POOL_WORKER));
+        worker->pool = pool;
+        worker->id = i;
+        if(pthread_create(&pool->threads[i], NULL, pool_thread, worker) != 0) {
+            free(worker);
+            pool->workers = i;
+            OML_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+void OML_pool_destroy(struct OML_POOL* pool) {
+    if(pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for(size_t i = 1; i < pool->workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->threads);
+    free(pool->shares);
+    free(pool);
+}
+
+size_t OML_pool_workers(struct OML_POOL* pool) {
+    return pool->workers;
+}
+
+// calls `fn' over chunks covering [0, count) on every worker, and returns
+// once all of them are done
+void OML_pool_run(struct OML_POOL* pool, OML_POOL_FN fn, void* arg, size_t count) {
+    size_t workers = pool->workers;
+    size_t chunk = count / (workers * POOL_CHUNKS_PER_WORKER);
+    pool->chunk = chunk ? chunk : 1;
+    for(size_t i = 0; i < workers; i++) {
+        pool->shares[i].next = count * i / workers;
+        pool->shares[i].end = count * (i + 1) / workers;
+    }
+    pool->fn = fn;
+    pool->arg = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy = workers - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->busy) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
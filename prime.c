@@ -0,0 +1,151 @@
+// primality testing for `eP'
+
+#include <pthread.h>    /* for pthread_once */
+#include <stdint.h>     /* for uint64_t */
+
+#include "OML.h"
+
+// numbers below this are looked up in a sieve
+#define PRIME_SIEVE_LIMIT   (1 << 16)
+
+// whether each odd number 2i + 1 below PRIME_SIEVE_LIMIT is prime, by bit
+static uint64_t prime_sieve[PRIME_SIEVE_LIMIT / 128];
+static pthread_once_t prime_sieve_once = PTHREAD_ONCE_INIT;
+
+static void prime_sieve_init(void) {
+    for(size_t i = 0; i < PRIME_SIEVE_LIMIT / 128; i++) {
+        prime_sieve[i] = ~(uint64_t) 0;
+    }
+    // 1 is not prime
+    prime_sieve[0] &= ~(uint64_t) 1;
+    for(uint64_t p = 3; p * p < PRIME_SIEVE_LIMIT; p += 2) {
+        if(prime_sieve[p / 128] >> (p / 2 % 64) & 1) {
+            for(uint64_t m = p * p; m < PRIME_SIEVE_LIMIT; m += 2 * p) {
+                prime_sieve[m / 128] &= ~((uint64_t) 1 << (m / 2 % 64));
+            }
+        }
+    }
+}
+
+/*
+ * The odd primes p up to 53, each as its inverse modulo 2^64 and the limit
+ * (2^64 - 1) / p: n is a multiple of p exactly when n * inverse <= limit,
+ * which tests for a factor with a multiplication in place of a division.
+ */
+static const struct { uint64_t inverse, limit; } PRIME_DIVISORS[] = {
+    { 0xaaaaaaaaaaaaaaabull, UINT64_MAX / 3 },  { 0xcccccccccccccccdull, UINT64_MAX / 5 },
+    { 0x6db6db6db6db6db7ull, UINT64_MAX / 7 },  { 0x2e8ba2e8ba2e8ba3ull, UINT64_MAX / 11 },
+    { 0x4ec4ec4ec4ec4ec5ull, UINT64_MAX / 13 }, { 0xf0f0f0f0f0f0f0f1ull, UINT64_MAX / 17 },
+    { 0x86bca1af286bca1bull, UINT64_MAX / 19 }, { 0xd37a6f4de9bd37a7ull, UINT64_MAX / 23 },
+    { 0x34f72c234f72c235ull, UINT64_MAX / 29 }, { 0xef7bdef7bdef7bdfull, UINT64_MAX / 31 },
+    { 0x14c1bacf914c1badull, UINT64_MAX / 37 }, { 0x8f9c18f9c18f9c19ull, UINT64_MAX / 41 },
+    { 0x82fa0be82fa0be83ull, UINT64_MAX / 43 }, { 0x51b3bea3677d46cfull, UINT64_MAX / 47 },
+    { 0x21cfb2b78c13521dull, UINT64_MAX / 53 },
+};
+
+/*
+ * Arithmetic modulo an odd n in Montgomery form, where x stands for
+ * x 2^64 mod n: a product then needs no division, as the 128-bit result is
+ * reduced by adding the multiple of n that clears its low word.
+ */
+typedef struct PRIME_MONT {
+    uint64_t n;
+    uint64_t inverse;       /* n^-1 mod 2^64 */
+    uint64_t one;           /* 2^64 mod n, 1 in Montgomery form */
+    uint64_t r2;            /* 2^128 mod n, for converting into the form */
+} PRIME_MONT;
+
+static inline uint64_t mont_reduce(const PRIME_MONT* m, __uint128_t t) {
+    uint64_t q = (uint64_t) t * m->inverse;
+    uint64_t high = t >> 64;
+    uint64_t qn = ((__uint128_t) q * m->n) >> 64;
+    // the low words of t and q n are equal, so only the high words differ
+    return high >= qn ? high - qn : high - qn + m->n;
+}
+
+static inline uint64_t mont_mul(const PRIME_MONT* m, uint64_t a, uint64_t b) {
+    return mont_reduce(m, (__uint128_t) a * b);
+}
+
+static void mont_init(PRIME_MONT* m, uint64_t n) {
+    m->n = n;
+    // Newton's iteration doubles the correct low bits each step, from 3
+    uint64_t inv = n;
+    for(int i = 0; i < 5; i++) {
+        inv *= 2 - n * inv;
+    }
+    m->inverse = inv;
+    m->one = -n % n;
+    m->r2 = ((__uint128_t) m->one * m->one) % n;
+}
+
+// whether the Miller-Rabin test with `base' finds the odd n = d 2^s + 1
+// probably prime
+static bool prime_witness(const PRIME_MONT* m, uint64_t base, uint64_t d, int s) {
+    base %= m->n;
+    if(base == 0) {
+        return true;
+    }
+    uint64_t minus_one = m->n - m->one;
+    uint64_t b = mont_mul(m, base, m->r2);
+    uint64_t x = m->one;
+    for(; d; d >>= 1) {
+        if(d & 1) {
+            x = mont_mul(m, x, b);
+        }
+        b = mont_mul(m, b, b);
+    }
+    if(x == m->one || x == minus_one) {
+        return true;
+    }
+    while(--s > 0) {
+        x = mont_mul(m, x, x);
+        if(x == minus_one) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Whether n is prime. Small numbers are looked up in a sieve; others are
+ * first checked for small factors, then given the Miller-Rabin test with
+ * bases known to have no pseudoprime among the numbers tested, so that the
+ * answer is exact: 2, 7 and 61 below 2^32, and the seven bases found by
+ * Jim Sinclair for all 64-bit numbers.
+ */
+bool is_prime(int64_t n) {
+    static const uint64_t BASES_32[] = { 2, 7, 61 };
+    static const uint64_t BASES_64[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+    if(n < PRIME_SIEVE_LIMIT) {
+        if(n < 3) {
+            return n == 2;
+        }
+        pthread_once(&prime_sieve_once, prime_sieve_init);
+        return (n & 1) && prime_sieve[n / 128] >> (n / 2 % 64) & 1;
+    }
+    if((n & 1) == 0) {
+        return false;
+    }
+    for(size_t i = 0; i < sizeof(PRIME_DIVISORS) / sizeof(*PRIME_DIVISORS); i++) {
+        if((uint64_t) n * PRIME_DIVISORS[i].inverse <= PRIME_DIVISORS[i].limit) {
+            return false;
+        }
+    }
+
+    PRIME_MONT m;
+    mont_init(&m, n);
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+    const uint64_t* bases = n >> 32 ? BASES_64 : BASES_32;
+    size_t count = n >> 32 ? sizeof(BASES_64) / sizeof(*BASES_64)
+                           : sizeof(BASES_32) / sizeof(*BASES_32);
+    for(size_t i = 0; i < count; i++) {
+        if(!prime_witness(&m, bases[i], d, s)) {
+            return false;
+        }
+    }
+    return true;
+}
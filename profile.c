@@ -0,0 +1,291 @@
+// the execution profiler of -p, counting time by position in the source
+
+#include <stdio.h>      /* for FILE, fopen, fprintf, fputc */
+#include <stdlib.h>     /* for calloc, malloc, free, qsort */
+#include <string.h>     /* for strlen */
+#include <time.h>       /* for clock_gettime */
+
+#include "OML.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>  /* for __rdtsc */
+    #define PROFILE_UNIT    "cycles"
+#else
+    #define PROFILE_UNIT    "ns"
+#endif
+
+/*
+ * Profiling runs through a dispatch table of its own, so an instance that
+ * is not profiled pays nothing for it. Each instruction dispatched is
+ * counted, and the clock is read: the time since the last reading is
+ * charged to the instruction dispatched before, so that a body run by a
+ * map, a reduce or a loop is charged to its own instructions and only the
+ * rest to the command running it. Compiled loops and vector kernels are
+ * charged to the command that starts them.
+ */
+typedef struct OML_PROFILE {
+    const OML_PROGRAM* prog;
+    uint64_t* counts;       /* times each instruction was dispatched */
+    uint64_t* ticks;        /* time charged to each instruction */
+    size_t pc;              /* the instruction being timed */
+    uint64_t since;         /* when it was dispatched */
+    bool timing;            /* whether one is being timed */
+} OML_PROFILE;
+
+static inline uint64_t profile_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+// a profile of the instructions of `prog', which must be optimized already
+OML_PROFILE* OML_profile_init(const OML_PROGRAM* prog) {
+    OML_PROFILE* prof = malloc(sizeof(OML_PROFILE));
+    prof->prog = prog;
+    prof->counts = calloc(prog->size + 1, sizeof(uint64_t));
+    prof->ticks = calloc(prog->size + 1, sizeof(uint64_t));
+    prof->pc = 0;
+    prof->since = 0;
+    prof->timing = false;
+    return prof;
+}
+
+void OML_profile_destroy(OML_PROFILE* prof) {
+    if(!prof) {
+        return;
+    }
+    free(prof->counts);
+    free(prof->ticks);
+    free(prof);
+}
+
+// counts instruction `pc' and starts timing it
+static inline void OML_profile_tick(OML_PROFILE* prof, size_t pc) {
+    uint64_t now = profile_clock();
+    if(prof->timing) {
+        prof->ticks[prof->pc] += now - prof->since;
+    }
+    prof->counts[pc]++;
+    prof->pc = pc;
+    prof->since = now;
+    prof->timing = true;
+}
+
+// charges the instruction being timed, at the end of a run
+void OML_profile_stop(OML_PROFILE* prof) {
+    if(prof->timing) {
+        prof->ticks[prof->pc] += profile_clock() - prof->since;
+        prof->timing = false;
+    }
+}
+
+/*
+ * The totals of one command: instructions are grouped by opcode, those
+ * substituted by OML_set_bigint by the opcode they stand in for.
+ * Those made by the optimizer, or that stand for a literal, are named for
+ * what they do; the others by their command at its first occurrence.
+ */
+typedef struct PROFILE_COMMAND {
+    char name[8];
+    uint64_t count, ticks;
+} PROFILE_COMMAND;
+
+static const char* const PROFILE_NAMES[OP_COUNT] = {
+    [OP_PUSH] = "literal",      [OP_STRING] = "string",     [OP_ADD_IMM] = "k+",
+    [OP_MUL_IMM] = "k*",        [OP_MOD_IMM] = "k%",        [OP_SQUARE] = "n",
+    [OP_BIG_SQUARE] = "n",      [OP_NIP] = ",$",
+};
+
+// the name of the command at `offset' of the source of `inst'
+static void profile_name(OML* inst, size_t offset, char* name) {
+    size_t length = 0;
+    if(offset < inst->size) {
+        name[length++] = inst->code[offset];
+        if(inst->code[offset] == 'e' && offset + 1 < inst->size) {
+            name[length++] = inst->code[offset + 1];
+        }
+    }
+    name[length] = '\0';
+}
+
+static int profile_command_compare(const void* a, const void* b) {
+    const PROFILE_COMMAND* x = a;
+    const PROFILE_COMMAND* y = b;
+    if(x->ticks != y->ticks) {
+        return x->ticks < y->ticks ? 1 : -1;
+    }
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+// the commands that ran, hottest first; gives their number in `count'
+static PROFILE_COMMAND* profile_commands(OML* inst, size_t* count) {
+    const OML_PROGRAM* prog = inst->profile->prog;
+    PROFILE_COMMAND* commands = calloc(OP_COUNT, sizeof(PROFILE_COMMAND));
+    for(size_t pc = 0; pc < prog->size; pc++) {
+        const OML_INSTR* instr = &prog->instrs[pc];
+        int op = instr->op == OP_BIG_VECTOR || instr->op == OP_BIG_WRAPPED ? instr->value : instr->op;
+        PROFILE_COMMAND* command = &commands[op];
+        if(!inst->profile->counts[pc]) {
+            continue;
+        }
+        if(!command->count) {
+            if(PROFILE_NAMES[op]) {
+                snprintf(command->name, sizeof(command->name), "%s", PROFILE_NAMES[op]);
+            }
+            else {
+                profile_name(inst, instr->src, command->name);
+            }
+        }
+        command->count += inst->profile->counts[pc];
+        command->ticks += inst->profile->ticks[pc];
+    }
+    qsort(commands, OP_COUNT, sizeof(PROFILE_COMMAND), profile_command_compare);
+    *count = 0;
+    while(*count < OP_COUNT && commands[*count].count) {
+        ++*count;
+    }
+    return commands;
+}
+
+// the counts and time of the instructions at each offset of the source
+static void profile_positions(OML* inst, uint64_t* counts, uint64_t* ticks) {
+    const OML_PROGRAM* prog = inst->profile->prog;
+    for(size_t pc = 0; pc < prog->size; pc++) {
+        size_t offset = prog->instrs[pc].src;
+        if(offset < inst->size) {
+            counts[offset] += inst->profile->counts[pc];
+            ticks[offset] += inst->profile->ticks[pc];
+        }
+    }
+}
+
+/*
+ * Writes the source of `inst' to descriptor `fd' with each character in
+ * the color of the time spent on it, followed by the time of each command.
+ * Characters that compiled to no instruction of their own, such as the `+'
+ * of `1+', take the color of the instruction before them.
+ */
+void OML_profile_report(OML* inst, int fd) {
+    OML_PROFILE* prof = inst->profile;
+    uint64_t* counts = calloc(inst->size + 1, sizeof(uint64_t));
+    uint64_t* ticks = calloc(inst->size + 1, sizeof(uint64_t));
+    bool* starts = calloc(inst->size + 1, sizeof(bool));
+    profile_positions(inst, counts, ticks);
+    for(size_t pc = 0; pc < prof->prog->size; pc++) {
+        if(prof->prog->instrs[pc].src < inst->size) {
+            starts[prof->prog->instrs[pc].src] = true;
+        }
+    }
+    uint64_t total = 0, hottest = 0;
+    for(size_t i = 0; i < inst->size; i++) {
+        total += ticks[i];
+        hottest = ticks[i] > hottest ? ticks[i] : hottest;
+    }
+
+    out_printf(inst->out, fd, COLOR_HEADER("[PROFILE, %llu " PROFILE_UNIT "]") "\n",
+        (unsigned long long) total);
+    out_printf(inst->out, fd, COLOR_SUB_HEADER("(CODE)") " not run, "
+        COLOR_CODE("cold") ", " COLOR_SUB_HEADER("warm") ", " COLOR_HEADER("hot") "\n  ");
+    size_t owner = inst->size;
+    for(size_t i = 0; i < inst->size; i++) {
+        char c = inst->code[i];
+        if(starts[i]) {
+            owner = i;
+        }
+        if(c == '\n') {
+            out_printf(inst->out, fd, "\n  ");
+        }
+        else if(owner == inst->size || !counts[owner] || c == ' ' || c == '\t') {
+            out_char(inst->out, fd, c);
+        }
+        // hot within a factor of 4 of the hottest, warm within one of 64
+        else if(ticks[owner] * 4 >= hottest) {
+            out_printf(inst->out, fd, COLOR_HEADER("%c"), c);
+        }
+        else if(ticks[owner] * 64 >= hottest) {
+            out_printf(inst->out, fd, COLOR_SUB_HEADER("%c"), c);
+        }
+        else {
+            out_printf(inst->out, fd, COLOR_CODE("%c"), c);
+        }
+    }
+    out_char(inst->out, fd, '\n');
+
+    size_t count;
+    PROFILE_COMMAND* commands = profile_commands(inst, &count);
+    out_printf(inst->out, fd, COLOR_SUB_HEADER("(COMMANDS)") "\n");
+    out_printf(inst->out, fd, "  %-8s %14s %18s %7s\n", "command", "count", PROFILE_UNIT, "share");
+    for(size_t i = 0; i < count; i++) {
+        out_printf(inst->out, fd, "  %-8s %14llu %18llu %6.1f%%\n", commands[i].name,
+            (unsigned long long) commands[i].count, (unsigned long long) commands[i].ticks,
+            total ? 100.0 * commands[i].ticks / total : 0.0);
+    }
+    free(commands);
+    free(counts);
+    free(ticks);
+    free(starts);
+}
+
+static void profile_json_string(FILE* file, const char* str, size_t size) {
+    fputc('"', file);
+    for(size_t i = 0; i < size; i++) {
+        unsigned char c = str[i];
+        if(c == '"' || c == '\\') {
+            fprintf(file, "\\%c", c);
+        }
+        else if(c < 0x20 || c == 0x7f) {
+            fprintf(file, "\\u%04x", c);
+        }
+        else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// writes the profile of `inst' to the file at `path' as JSON, commands
+// hottest first; false if the file cannot be written
+bool OML_profile_save(OML* inst, const char* path) {
+    FILE* file = fopen(path, "w");
+    if(!file) {
+        return false;
+    }
+    uint64_t* counts = calloc(inst->size + 1, sizeof(uint64_t));
+    uint64_t* ticks = calloc(inst->size + 1, sizeof(uint64_t));
+    profile_positions(inst, counts, ticks);
+
+    fprintf(file, "{\"unit\":\"" PROFILE_UNIT "\",\"source\":");
+    profile_json_string(file, inst->code, inst->size);
+    fprintf(file, ",\"positions\":[");
+    bool first = true;
+    for(size_t i = 0; i < inst->size; i++) {
+        if(!counts[i]) {
+            continue;
+        }
+        char name[8];
+        profile_name(inst, i, name);
+        fprintf(file, "%s{\"offset\":%lu,\"command\":", first ? "" : ",", (unsigned long) i);
+        profile_json_string(file, name, strlen(name));
+        fprintf(file, ",\"count\":%llu,\"ticks\":%llu}",
+            (unsigned long long) counts[i], (unsigned long long) ticks[i]);
+        first = false;
+    }
+    fprintf(file, "],\"commands\":[");
+    size_t count;
+    PROFILE_COMMAND* commands = profile_commands(inst, &count);
+    for(size_t i = 0; i < count; i++) {
+        fprintf(file, "%s{\"command\":", i ? "," : "");
+        profile_json_string(file, commands[i].name, strlen(commands[i].name));
+        fprintf(file, ",\"count\":%llu,\"ticks\":%llu}",
+            (unsigned long long) commands[i].count, (unsigned long long) commands[i].ticks);
+    }
+    fprintf(file, "]}\n");
+    free(commands);
+    free(counts);
+    free(ticks);
+    return fclose(file) == 0;
+}
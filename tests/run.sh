@@ -0,0 +1,31 @@
+#!/bin/sh
+# runs the cases of tests/cases.txt through the interpreter given, or ./OML,
+# and reports those whose output or exit code differs
+oml=${1:-./OML}
+cases=$(dirname "$0")/cases.txt
+failed=0
+total=0
+while IFS= read -r line; do
+    case "$line" in
+        ''|'#'*) continue ;;
+    esac
+    name=$(printf '%s\n' "$line" | cut -f1)
+    flags=$(printf '%s\n' "$line" | cut -f2)
+    input=$(printf '%s\n' "$line" | cut -f3)
+    program=$(printf '%s\n' "$line" | cut -f4)
+    expected=$(printf '%s\n' "$line" | cut -f5)
+    code=$(printf '%s\n' "$line" | cut -f6)
+    [ "$flags" = - ] && flags=
+    [ "$input" = - ] && input=
+    [ -z "$code" ] && code=0
+    actual=$(printf '%b' "$input" | $oml $flags "$program" 2>/dev/null; echo "rc=$?")
+    wanted=$(printf '%b' "$expected"; echo "rc=$code")
+    total=$((total + 1))
+    if [ "$actual" != "$wanted" ]; then
+        failed=$((failed + 1))
+        echo "FAIL $name: $oml $flags '$program'"
+        printf '  expected: %s\n  got:      %s\n' "$wanted" "$actual"
+    fi
+done < "$cases"
+echo "$((total - failed)) of $total passed"
+[ "$failed" -eq 0 ]
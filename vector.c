@@ -0,0 +1,426 @@
+// whole-stack arithmetic for the vector commands
+
+#include <stdint.h>     /* for int64_t */
+
+#include "OML.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>  /* for the AVX2 intrinsics */
+#define VEC_AVX2
+#endif
+
+/*
+ * Each command works on the members of the current stack in place, made
+ * contiguous first, so a loop can run straight over them (see VEC_RUNS for
+ * when they cannot be). Every operation
+ * has a plain loop, and on x86-64 a kernel using AVX2 four members at a
+ * time, picked when the CPU running the program has it. Arithmetic wraps
+ * as the single commands do, unless big numbers are on (see vec_big). AVX2
+ * has no 64-bit division, so `e%' always runs the plain loop.
+ */
+typedef struct VEC_KERNELS {
+    void    (*add)      (int64_t*, size_t, int64_t);
+    void    (*mul)      (int64_t*, size_t, int64_t);
+    int64_t (*sum)      (const int64_t*, size_t);
+    int64_t (*product)  (const int64_t*, size_t);
+    int64_t (*min)      (const int64_t*, size_t);
+    int64_t (*max)      (const int64_t*, size_t);
+    void    (*scan)     (int64_t*, size_t);
+    void    (*diff)     (int64_t*, size_t);
+    void    (*reverse)  (int64_t*, size_t);
+} VEC_KERNELS;
+
+static void vec_add(int64_t* a, size_t n, int64_t k) {
+    for(size_t i = 0; i < n; i++) {
+        a[i] = (uint64_t) a[i] + k;
+    }
+}
+
+static void vec_mul(int64_t* a, size_t n, int64_t k) {
+    for(size_t i = 0; i < n; i++) {
+        a[i] = (uint64_t) a[i] * k;
+    }
+}
+
+static int64_t vec_sum(const int64_t* a, size_t n) {
+    uint64_t res = 0;
+    for(size_t i = 0; i < n; i++) {
+        res += a[i];
+    }
+    return res;
+}
+
+static int64_t vec_product(const int64_t* a, size_t n) {
+    uint64_t res = 1;
+    for(size_t i = 0; i < n; i++) {
+        res *= a[i];
+    }
+    return res;
+}
+
+static int64_t vec_min(const int64_t* a, size_t n) {
+    int64_t res = a[0];
+    for(size_t i = 1; i < n; i++) {
+        res = a[i] < res ? a[i] : res;
+    }
+    return res;
+}
+
+static int64_t vec_max(const int64_t* a, size_t n) {
+    int64_t res = a[0];
+    for(size_t i = 1; i < n; i++) {
+        res = a[i] > res ? a[i] : res;
+    }
+    return res;
+}
+
+static void vec_scan(int64_t* a, size_t n) {
+    for(size_t i = 1; i < n; i++) {
+        a[i] = (uint64_t) a[i] + a[i - 1];
+    }
+}
+
+static void vec_diff(int64_t* a, size_t n) {
+    for(size_t i = n; i-- > 1;) {
+        a[i] = (uint64_t) a[i] - a[i - 1];
+    }
+}
+
+static void vec_reverse(int64_t* a, size_t n) {
+    for(size_t i = 0, j = n - 1; i < n / 2; i++, j--) {
+        int64_t t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+static const VEC_KERNELS VEC_SCALAR = {
+    vec_add, vec_mul, vec_sum, vec_product, vec_min, vec_max, vec_scan, vec_diff,
+    vec_reverse,
+};
+
+#ifdef VEC_AVX2
+#define VEC_TARGET __attribute__((target("avx2")))
+
+// the low 64 bits of each product; AVX2 multiplies only 32-bit halves
+VEC_TARGET static inline __m256i vec_mullo(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+VEC_TARGET static void vec_add_avx2(int64_t* a, size_t n, int64_t k) {
+    __m256i kv = _mm256_set1_epi64x(k);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((__m256i*) (a + i));
+        _mm256_storeu_si256((__m256i*) (a + i), _mm256_add_epi64(v, kv));
+    }
+    vec_add(a + i, n - i, k);
+}
+
+VEC_TARGET static void vec_mul_avx2(int64_t* a, size_t n, int64_t k) {
+    __m256i kv = _mm256_set1_epi64x(k);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((__m256i*) (a + i));
+        _mm256_storeu_si256((__m256i*) (a + i), vec_mullo(v, kv));
+    }
+    vec_mul(a + i, n - i, k);
+}
+
+VEC_TARGET static int64_t vec_sum_avx2(const int64_t* a, size_t n) {
+    // two accumulators, so that consecutive adds do not wait on each other
+    __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_epi64(s0, _mm256_loadu_si256((const __m256i*) (a + i)));
+        s1 = _mm256_add_epi64(s1, _mm256_loadu_si256((const __m256i*) (a + i + 4)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, _mm256_add_epi64(s0, s1));
+    return (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3] + vec_sum(a + i, n - i);
+}
+
+VEC_TARGET static int64_t vec_product_avx2(const int64_t* a, size_t n) {
+    __m256i p = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        p = vec_mullo(p, _mm256_loadu_si256((const __m256i*) (a + i)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, p);
+    return (uint64_t) lanes[0] * lanes[1] * lanes[2] * lanes[3] * vec_product(a + i, n - i);
+}
+
+VEC_TARGET static int64_t vec_min_avx2(const int64_t* a, size_t n) {
+    if(n < 4) {
+        return vec_min(a, n);
+    }
+    __m256i m = _mm256_loadu_si256((const __m256i*) a);
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (a + i));
+        m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(m, v));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, m);
+    int64_t res = vec_min(lanes, 4);
+    for(; i < n; i++) {
+        res = a[i] < res ? a[i] : res;
+    }
+    return res;
+}
+
+VEC_TARGET static int64_t vec_max_avx2(const int64_t* a, size_t n) {
+    if(n < 4) {
+        return vec_max(a, n);
+    }
+    __m256i m = _mm256_loadu_si256((const __m256i*) a);
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (a + i));
+        m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(v, m));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, m);
+    int64_t res = vec_max(lanes, 4);
+    for(; i < n; i++) {
+        res = a[i] > res ? a[i] : res;
+    }
+    return res;
+}
+
+// running totals within each group of four, in two shifted adds, plus the
+// total of everything before the group
+VEC_TARGET static void vec_scan_avx2(int64_t* a, size_t n) {
+    __m256i carry = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((__m256i*) (a + i));
+        // v + (0, v0, v1, v2), then + (0, 0, v0', v1')
+        v = _mm256_add_epi64(v, _mm256_blend_epi32(
+                _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 1, 0, 0)), _mm256_setzero_si256(), 0x03));
+        v = _mm256_add_epi64(v, _mm256_blend_epi32(
+                _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 0, 0)), _mm256_setzero_si256(), 0x0f));
+        v = _mm256_add_epi64(v, carry);
+        _mm256_storeu_si256((__m256i*) (a + i), v);
+        carry = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    for(; i < n; i++) {
+        a[i] = (uint64_t) a[i] + (i ? a[i - 1] : 0);
+    }
+}
+
+// from the top down, so that every member is read before it changes
+VEC_TARGET static void vec_diff_avx2(int64_t* a, size_t n) {
+    size_t i = n;
+    while(i >= 5) {
+        i -= 4;
+        __m256i v = _mm256_loadu_si256((__m256i*) (a + i));
+        __m256i below = _mm256_loadu_si256((__m256i*) (a + i - 1));
+        _mm256_storeu_si256((__m256i*) (a + i), _mm256_sub_epi64(v, below));
+    }
+    vec_diff(a, i);
+}
+
+// swaps groups of four from the two ends, each turned around in its register
+VEC_TARGET static void vec_reverse_avx2(int64_t* a, size_t n) {
+    size_t i = 0, j = n;
+    for(; j - i >= 8; i += 4, j -= 4) {
+        __m256i lo = _mm256_loadu_si256((__m256i*) (a + i));
+        __m256i hi = _mm256_loadu_si256((__m256i*) (a + j - 4));
+        _mm256_storeu_si256((__m256i*) (a + i), _mm256_permute4x64_epi64(hi, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm256_storeu_si256((__m256i*) (a + j - 4), _mm256_permute4x64_epi64(lo, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    vec_reverse(a + i, j - i);
+}
+
+static const VEC_KERNELS VEC_AVX2_KERNELS = {
+    vec_add_avx2, vec_mul_avx2, vec_sum_avx2, vec_product_avx2,
+    vec_min_avx2, vec_max_avx2, vec_scan_avx2, vec_diff_avx2,
+    vec_reverse_avx2,
+};
+#endif
+
+static const VEC_KERNELS* vec_kernels(void) {
+#ifdef VEC_AVX2
+    if(__builtin_cpu_supports("avx2")) {
+        return &VEC_AVX2_KERNELS;
+    }
+#endif
+    return &VEC_SCALAR;
+}
+
+// fewer members than this are swapped where they lie in the ring, rather
+// than made contiguous for a kernel
+#define VEC_REVERSE_MIN (32)
+
+/*
+ * The members of `stk' as at most two runs lying contiguous in memory:
+ * made contiguous, they are all in the first, but if there is no memory to
+ * move them they stay where they lie, split at the end of the ring. The
+ * commands then run their kernels over each run and join the results.
+ */
+typedef struct VEC_RUNS {
+    int64_t* at[2];
+    size_t size[2];
+} VEC_RUNS;
+
+static VEC_RUNS vec_runs(STACK* stk) {
+    bool linear = stack_linearize(stk);
+    VEC_RUNS runs = { { &STACK_AT(stk, 0), stk->data }, { stk->size, 0 } };
+    size_t first = stk->capacity - (runs.at[0] - stk->data);
+    if(!linear && first < stk->size) {
+        runs.size[0] = first;
+        runs.size[1] = stk->size - first;
+    }
+    return runs;
+}
+
+void stack_add_all(STACK* stk, int64_t k) {
+    VEC_RUNS runs = vec_runs(stk);
+    for(int r = 0; r < 2; r++) {
+        vec_kernels()->add(runs.at[r], runs.size[r], k);
+    }
+}
+
+void stack_mul_all(STACK* stk, int64_t k) {
+    VEC_RUNS runs = vec_runs(stk);
+    for(int r = 0; r < 2; r++) {
+        vec_kernels()->mul(runs.at[r], runs.size[r], k);
+    }
+}
+
+void stack_mod_all(STACK* stk, int64_t k) {
+    for(size_t i = 0; i < stk->size; i++) {
+        STACK_AT(stk, i) %= k;
+    }
+}
+
+// the sum of the members, or 0 for none
+int64_t stack_sum(STACK* stk) {
+    VEC_RUNS runs = vec_runs(stk);
+    return (uint64_t) vec_kernels()->sum(runs.at[0], runs.size[0])
+        + vec_kernels()->sum(runs.at[1], runs.size[1]);
+}
+
+// the product of the members, or 1 for none
+int64_t stack_product(STACK* stk) {
+    VEC_RUNS runs = vec_runs(stk);
+    return (uint64_t) vec_kernels()->product(runs.at[0], runs.size[0])
+        * vec_kernels()->product(runs.at[1], runs.size[1]);
+}
+
+// the least member, or 0 for none
+int64_t stack_min(STACK* stk) {
+    if(!stk->size) {
+        return 0;
+    }
+    VEC_RUNS runs = vec_runs(stk);
+    int64_t res = vec_kernels()->min(runs.at[0], runs.size[0]);
+    if(runs.size[1]) {
+        int64_t rest = vec_kernels()->min(runs.at[1], runs.size[1]);
+        res = rest < res ? rest : res;
+    }
+    return res;
+}
+
+// the greatest member, or 0 for none
+int64_t stack_max(STACK* stk) {
+    if(!stk->size) {
+        return 0;
+    }
+    VEC_RUNS runs = vec_runs(stk);
+    int64_t res = vec_kernels()->max(runs.at[0], runs.size[0]);
+    if(runs.size[1]) {
+        int64_t rest = vec_kernels()->max(runs.at[1], runs.size[1]);
+        res = rest > res ? rest : res;
+    }
+    return res;
+}
+
+/*
+ * Reverses the top `count' members in place. Counting past the bottom takes
+ * in the zeroes that popping there would give, which end up on top.
+ */
+void stack_reverse_top(STACK* stk, int64_t count) {
+    if(count <= 0) {
+        return;
+    }
+    size_t missing = 0;
+    if((uint64_t) count > stk->size) {
+        missing = count - stk->size;
+        count = stk->size;
+    }
+    size_t from = stk->size - count;
+    if(count >= VEC_REVERSE_MIN && stack_linearize(stk)) {
+        vec_kernels()->reverse(&STACK_AT(stk, from), count);
+    }
+    else if(count > 1) {
+        for(size_t i = from, j = stk->size - 1; i < j; i++, j--) {
+            int64_t t = STACK_AT(stk, i);
+            STACK_AT(stk, i) = STACK_AT(stk, j);
+            STACK_AT(stk, j) = t;
+        }
+    }
+    while(missing --> 0) {
+        stack_push(stk, 0);
+    }
+}
+
+// replaces each member by the sum of it and every member below it
+void stack_scan(STACK* stk) {
+    VEC_RUNS runs = vec_runs(stk);
+    vec_kernels()->scan(runs.at[0], runs.size[0]);
+    if(runs.size[1]) {
+        vec_kernels()->scan(runs.at[1], runs.size[1]);
+        vec_kernels()->add(runs.at[1], runs.size[1], runs.at[0][runs.size[0] - 1]);
+    }
+}
+
+// replaces each member above the bottom by how much it exceeds the one
+// below it, undoing stack_scan
+void stack_differences(STACK* stk) {
+    VEC_RUNS runs = vec_runs(stk);
+    if(runs.size[1]) {
+        vec_kernels()->diff(runs.at[1], runs.size[1]);
+        runs.at[1][0] = (uint64_t) runs.at[1][0] - runs.at[0][runs.size[0] - 1];
+    }
+    vec_kernels()->diff(runs.at[0], runs.size[0]);
+}
+
+/*
+ * The whole-stack command `op' under OML_set_bigint, one member at a time
+ * with the checked arithmetic, so that results past 63 bits become big
+ * numbers as they do for the single commands.
+ */
+static void vec_big(OML* inst, STACK* stk, int op) {
+    int64_t k = 0;
+    if(op == OP_ADD_ALL || op == OP_MUL_ALL || op == OP_MOD_ALL) {
+        k = stack_pop(stk);
+    }
+    size_t n = stk->size;
+    int64_t res = op == OP_PRODUCT ? 1 : n ? STACK_AT(stk, 0) : 0;
+    int64_t below = n ? STACK_AT(stk, 0) : 0;
+    for(size_t i = 0; i < n; i++) {
+        int64_t* a = &STACK_AT(stk, i);
+        int64_t quot, x = *a;
+        switch(op) {
+            case OP_ADD_ALL:        *a = big_add(inst, x, k); break;
+            case OP_MUL_ALL:        *a = big_mul(inst, x, k); break;
+            case OP_MOD_ALL:        big_divmod(inst, x, k, &quot, a); break;
+            case OP_SUM:            res = i ? big_add(inst, res, x) : x; break;
+            case OP_PRODUCT:        res = big_mul(inst, res, x); break;
+            case OP_MINIMUM:        res = big_compare(x, res) < 0 ? x : res; break;
+            case OP_MAXIMUM:        res = big_compare(x, res) > 0 ? x : res; break;
+            case OP_SCAN:           *a = i ? big_add(inst, STACK_AT(stk, i - 1), x) : x; break;
+            case OP_DIFFERENCES:    *a = i ? big_sub(inst, x, below) : x; below = x; break;
+        }
+    }
+    if(op == OP_SUM || op == OP_PRODUCT || op == OP_MINIMUM || op == OP_MAXIMUM) {
+        stack_clear(stk);
+        stack_push(stk, res);
+    }
+}
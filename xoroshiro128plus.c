@@ -31,13 +31,12 @@ See <http://creativecommons.org/publicdomain/zero/1.0/>. */
    a 64-bit seed, we suggest to seed a splitmix64 generator and use its
    output to fill s. */
 
-uint64_t s[2];
-
+// the state is passed in, so that every interpreter can have its own
 static inline uint64_t rotl(const uint64_t x, int k) {
 	return (x << k) | (x >> (64 - k));
 }
 
-uint64_t next(void) {
+static uint64_t next(uint64_t* s) {
 	const uint64_t s0 = s[0];
 	uint64_t s1 = s[1];
 	const uint64_t result = s0 + s1;
@@ -50,21 +49,32 @@ uint64_t next(void) {
 }
 
 // added by Conor O'Brien
-void seed(uint64_t x, uint64_t y) {
+static void seed(uint64_t* s, uint64_t x, uint64_t y) {
     s[0] = x;
     s[1] = y;
     // add 3 next calls to ensure the sizes of x and y do not
     // proliferate into the random values
-    next();
-    next();
-    next();
+    next(s);
+    next(s);
+    next(s);
+}
+
+// added: fills s from a single 64-bit value through splitmix64, as
+// suggested above, so that every value gives a usable, distinct state
+static void seed_from(uint64_t* s, uint64_t x) {
+    for(int i = 0; i < 2; i++) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        s[i] = z ^ (z >> 31);
+    }
 }
 
 /* This is the jump function for the generator. It is equivalent
    to 2^64 calls to next(); it can be used to generate 2^64
    non-overlapping subsequences for parallel computations. */
 
-void jump(void) {
+static inline void jump(uint64_t* s) {
 	static const uint64_t JUMP[] = { 0xbeac0467eba5facb, 0xd86b048b86aa9922 };
 
 	uint64_t s0 = 0;
@@ -76,7 +86,7 @@ void jump(void) {
 				s0 ^= s[0];
 				s1 ^= s[1];
 			}
-			next();
+			next(s);
 		}
 
 	s[0] = s0;